@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace skiplist {
+
+/*
+ * Node allocators.
+ *
+ * A skiplist allocator hands out raw memory for nodes. Every allocation is tagged with a size
+ * class (the level of the node), and a block is always returned with the same size and size class
+ * it was allocated with. An allocator with SupportsRelease set can drop all of its memory at once
+ * through Release(), which lets the skiplist skip freeing nodes one by one when it is cleared.
+ * An allocator with Interchangeable set lets any instance free a block allocated by another, so
+ * that nodes can be moved between skiplists by splitting or concatenating them.
+ */
+
+/* HeapAllocator forwards every request to the global operator new/delete. */
+class HeapAllocator {
+ public:
+  static constexpr const bool SupportsRelease = false;
+  static constexpr const bool Interchangeable = true;
+  void* Allocate(size_t bytes, size_t) { return ::operator new(bytes); }
+  void Deallocate(void* p, size_t, size_t) { ::operator delete(p); }
+  void Release() {}
+};
+
+/*
+ * Arena is a slab allocator. Blocks are carved out of large chunks, and freed blocks are kept in
+ * a free list per size class so that the next allocation of the same class reuses them. Release()
+ * gives back every chunk in O(chunks).
+ */
+class Arena {
+ public:
+  static constexpr const bool SupportsRelease = true;
+  static constexpr const bool Interchangeable = false;
+  static constexpr const size_t DefaultChunkSize = 64 * 1024;
+  explicit Arena(size_t chunk_size = DefaultChunkSize);
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  Arena(Arena&& arena);
+  Arena& operator=(Arena&& arena);
+  void* Allocate(size_t bytes, size_t size_class);
+  void Deallocate(void* p, size_t bytes, size_t size_class);
+  void Release();
+  size_t MemoryUsage() const { return memory_usage_; }
+  ~Arena() { Release(); }
+
+ private:
+  static constexpr const size_t Alignment = alignof(std::max_align_t);
+  struct FreeBlock {
+    FreeBlock* next_;
+  };
+  char* AllocateChunk(size_t bytes);
+  std::vector<char*> chunks_;
+  std::vector<FreeBlock*> free_lists_;
+  char* alloc_ptr_;
+  size_t alloc_bytes_remaining_;
+  size_t chunk_size_;
+  size_t memory_usage_;
+};
+
+inline Arena::Arena(size_t chunk_size)
+    : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), chunk_size_(chunk_size), memory_usage_(0) {}
+
+/* take over the chunks of the arena, which is left empty */
+inline Arena::Arena(Arena&& arena)
+    : chunks_(std::move(arena.chunks_)),
+      free_lists_(std::move(arena.free_lists_)),
+      alloc_ptr_(arena.alloc_ptr_),
+      alloc_bytes_remaining_(arena.alloc_bytes_remaining_),
+      chunk_size_(arena.chunk_size_),
+      memory_usage_(arena.memory_usage_) {
+  arena.chunks_.clear();
+  arena.Release();
+}
+
+inline Arena& Arena::operator=(Arena&& arena) {
+  if (this == &arena) return *this;
+
+  Release();
+  chunks_ = std::move(arena.chunks_);
+  free_lists_ = std::move(arena.free_lists_);
+  alloc_ptr_ = arena.alloc_ptr_;
+  alloc_bytes_remaining_ = arena.alloc_bytes_remaining_;
+  chunk_size_ = arena.chunk_size_;
+  memory_usage_ = arena.memory_usage_;
+  /* the chunks belong to this arena now */
+  arena.chunks_.clear();
+  arena.Release();
+  return *this;
+}
+
+inline void* Arena::Allocate(size_t bytes, size_t size_class) {
+  /* reuse a freed block of the same size class first */
+  if (size_class < free_lists_.size() && free_lists_[size_class]) {
+    FreeBlock* block = free_lists_[size_class];
+    free_lists_[size_class] = block->next_;
+    return block;
+  }
+
+  bytes = (bytes + Alignment - 1) & ~(Alignment - 1);
+  if (bytes > alloc_bytes_remaining_) {
+    if (bytes > chunk_size_ / 4) {
+      /* large blocks get a chunk of their own so the current chunk is not wasted */
+      return AllocateChunk(bytes);
+    }
+    alloc_ptr_ = AllocateChunk(chunk_size_);
+    alloc_bytes_remaining_ = chunk_size_;
+  }
+
+  char* result = alloc_ptr_;
+  alloc_ptr_ += bytes;
+  alloc_bytes_remaining_ -= bytes;
+  return result;
+}
+
+inline void Arena::Deallocate(void* p, size_t, size_t size_class) {
+  if (size_class >= free_lists_.size()) {
+    free_lists_.resize(size_class + 1, nullptr);
+  }
+  FreeBlock* block = static_cast<FreeBlock*>(p);
+  block->next_ = free_lists_[size_class];
+  free_lists_[size_class] = block;
+}
+
+inline void Arena::Release() {
+  for (char* chunk : chunks_) {
+    ::operator delete(chunk);
+  }
+  chunks_.clear();
+  free_lists_.clear();
+  alloc_ptr_ = nullptr;
+  alloc_bytes_remaining_ = 0;
+  memory_usage_ = 0;
+}
+
+inline char* Arena::AllocateChunk(size_t bytes) {
+  /* make room for the chunk first, so that it cannot leak if growing chunks_ throws */
+  chunks_.push_back(nullptr);
+  try {
+    chunks_.back() = static_cast<char*>(::operator new(bytes));
+  } catch (...) {
+    chunks_.pop_back();
+    throw;
+  }
+  memory_usage_ += bytes;
+  return chunks_.back();
+}
+
+}  // namespace skiplist
@@ -0,0 +1,61 @@
+#include "arena.h"
+
+#include <gtest/gtest.h>
+
+namespace skiplist {
+TEST(ArenaTest, Allocate) {
+  Arena arena(1024);
+  char* p1 = static_cast<char*>(arena.Allocate(40, 1));
+  char* p2 = static_cast<char*>(arena.Allocate(40, 1));
+  ASSERT_NE(p1, p2);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(p1) % alignof(std::max_align_t), 0);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(p2) % alignof(std::max_align_t), 0);
+  ASSERT_EQ(arena.MemoryUsage(), 1024);
+
+  /* large blocks get their own chunk */
+  arena.Allocate(2048, 8);
+  ASSERT_EQ(arena.MemoryUsage(), 1024 + 2048);
+}
+
+TEST(ArenaTest, Reuse) {
+  Arena arena(1024);
+  void* p1 = arena.Allocate(40, 1);
+  void* p2 = arena.Allocate(56, 2);
+  arena.Deallocate(p1, 40, 1);
+  arena.Deallocate(p2, 56, 2);
+
+  ASSERT_EQ(arena.Allocate(56, 2), p2);
+  ASSERT_EQ(arena.Allocate(40, 1), p1);
+  ASSERT_NE(arena.Allocate(40, 1), p1);
+}
+
+TEST(ArenaTest, Release) {
+  Arena arena(1024);
+  void* p = arena.Allocate(40, 1);
+  arena.Deallocate(p, 40, 1);
+  arena.Release();
+  ASSERT_EQ(arena.MemoryUsage(), 0);
+
+  arena.Allocate(40, 1);
+  ASSERT_EQ(arena.MemoryUsage(), 1024);
+}
+
+TEST(ArenaTest, Move) {
+  Arena arena(1024);
+  void* p = arena.Allocate(40, 1);
+  arena.Deallocate(p, 40, 1);
+
+  Arena moved(std::move(arena));
+  ASSERT_EQ(moved.MemoryUsage(), 1024);
+  ASSERT_EQ(arena.MemoryUsage(), 0);
+  /* the free lists move along with the chunks */
+  ASSERT_EQ(moved.Allocate(40, 1), p);
+  ASSERT_NE(arena.Allocate(40, 1), p);
+
+  Arena assigned(512);
+  assigned.Allocate(40, 1);
+  assigned = std::move(moved);
+  ASSERT_EQ(assigned.MemoryUsage(), 1024);
+  ASSERT_EQ(moved.MemoryUsage(), 0);
+}
+}  // namespace skiplist
@@ -1,10 +1,18 @@
 #include <benchmark/benchmark.h>
 
+#include <random>
+#include <sstream>
+
+#include "concurrent_skiplist.h"
+#include "frozen_skiplist.h"
 #include "skiplist.h"
 
 namespace skiplist {
 
-Skiplist<std::string> skiplist(16);
+/* seeded, so that every run builds the same skiplists */
+Skiplist<std::string> skiplist(16, default_compare<std::string>, RandomLevelPolicy<>(1));
+ArenaSkiplist<std::string> arena_skiplist(16, default_compare<std::string>, RandomLevelPolicy<>(1));
+ConcurrentSkiplist<int> concurrent_skiplist;
 std::vector<std::string> keys;
 
 std::string randString(const int len) {
@@ -30,6 +38,50 @@ static void Insert(benchmark::State& state) {
   }
 }
 
+static void ArenaInsert(benchmark::State& state) {
+  for (auto _ : state) {
+    arena_skiplist.Insert(randString(10));
+  }
+}
+
+static void BulkLoad(benchmark::State& state) {
+  std::vector<int> sorted(state.range(0));
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    sorted[i] = i;
+  }
+  ArenaSkiplist<int> bulk_skiplist;
+  for (auto _ : state) {
+    bulk_skiplist.BulkLoad(sorted.begin(), sorted.end());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void InsertBatch(benchmark::State& state) {
+  std::vector<int> batch(state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    ArenaSkiplist<int> batch_skiplist;
+    for (int i = 0; i < state.range(0); ++i) {
+      batch_skiplist.Insert(i * 4);
+      batch[i] = i * 4 + 1 + rand() % 3;
+    }
+    state.ResumeTiming();
+    batch_skiplist.InsertBatch(batch.begin(), batch.end());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void ConcurrentInsertAndSearch(benchmark::State& state) {
+  thread_local std::minstd_rand rng(state.thread_index());
+  for (auto _ : state) {
+    if (rng() % 4 == 0) {
+      concurrent_skiplist.Insert(rng() % 1000000);
+    } else {
+      concurrent_skiplist.Contains(rng() % 1000000);
+    }
+  }
+}
+
 static void Search(benchmark::State& state) {
   for (auto _ : state) {
     int exist = rand() % 2;
@@ -45,6 +97,134 @@ static void Search(benchmark::State& state) {
   }
 }
 
+/* search a skiplist of random strings with the given comparator */
+template <typename Comparator>
+static void SearchStrings(benchmark::State& state, const Comparator& compare) {
+  Skiplist<std::string, Comparator> strings(16, compare, RandomLevelPolicy<>(1));
+  std::vector<std::string> string_keys;
+  for (int i = 0; i < state.range(0); ++i) {
+    string_keys.push_back(randString(16));
+    strings.Insert(string_keys.back());
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(strings.Contains(string_keys[rand() % string_keys.size()]));
+  }
+}
+
+static void SearchDefaultCompare(benchmark::State& state) {
+  SearchStrings(state, default_compare<std::string>);
+}
+
+static void SearchPrefixCompare(benchmark::State& state) {
+  SearchStrings(state, StringPrefixCompare());
+}
+
+/* search integer keys, with the upper levels packed into a search index if state.range(1) is set */
+static void SearchIndex(benchmark::State& state) {
+  Skiplist<uint64_t, IntegerCompare<uint64_t>> integers(16, IntegerCompare<uint64_t>(),
+                                                        RandomLevelPolicy<>(1));
+  std::vector<uint64_t> integer_keys;
+  for (int i = 0; i < state.range(0); ++i) {
+    integer_keys.push_back(static_cast<uint64_t>(rand()) * RAND_MAX + rand());
+    integers.Insert(integer_keys.back());
+  }
+  if (state.range(1)) integers.BuildSearchIndex();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(integers.Contains(integer_keys[rand() % integer_keys.size()]));
+  }
+}
+
+/* search 1024 random keys one by one, or interleaved with ContainsMany if state.range(1) is set */
+static void SearchMany(benchmark::State& state) {
+  Skiplist<int> integers(16, default_compare<int>, RandomLevelPolicy<>(1));
+  for (int i = 0; i < state.range(0); ++i) {
+    integers.Insert(rand());
+  }
+  std::vector<int> lookups(1024);
+  for (auto _ : state) {
+    for (int& key : lookups) {
+      key = rand();
+    }
+    if (state.range(1)) {
+      benchmark::DoNotOptimize(integers.ContainsMany(lookups.begin(), lookups.end()));
+    } else {
+      for (int key : lookups) {
+        benchmark::DoNotOptimize(integers.Contains(key));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * lookups.size());
+}
+
+/* intersect a skiplist of state.range(0) keys with one of state.range(1) keys */
+static void Intersect(benchmark::State& state) {
+  Skiplist<int> large(16, default_compare<int>, RandomLevelPolicy<>(1));
+  Skiplist<int> small(16, default_compare<int>, RandomLevelPolicy<>(2));
+  for (int i = 0; i < state.range(0); ++i) {
+    large.Insert(rand());
+  }
+  for (int i = 0; i < state.range(1); ++i) {
+    small.Insert(rand());
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(large.Intersect(small));
+  }
+}
+
+/* merge 16 skiplists of 64K keys each with state.range(0) threads */
+static void MergeMany(benchmark::State& state) {
+  std::vector<Skiplist<int>> skiplists;
+  std::vector<const Skiplist<int>*> others;
+  for (int i = 0; i < 16; ++i) {
+    skiplists.emplace_back(16, default_compare<int>, RandomLevelPolicy<>(i));
+    for (int j = 0; j < (1 << 16); ++j) {
+      skiplists.back().Insert(rand());
+    }
+  }
+  for (size_t i = 1; i < skiplists.size(); ++i) {
+    others.push_back(&skiplists[i]);
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(skiplists[0].MergeMany(others, state.range(0)));
+  }
+}
+
+/* reload a snapshot of state.range(0) keys */
+static void LoadSnapshot(benchmark::State& state) {
+  Skiplist<int> integers(16, default_compare<int>, RandomLevelPolicy<>(1));
+  for (int i = 0; i < state.range(0); ++i) {
+    integers.Insert(rand());
+  }
+  std::stringstream snapshot;
+  integers.SaveSnapshot(snapshot);
+  const std::string data = snapshot.str();
+  ArenaSkiplist<int> loaded;
+  for (auto _ : state) {
+    std::istringstream in(data);
+    loaded.LoadSnapshot(in);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/* open a frozen copy of state.range(0) keys, then search it */
+static void FrozenSearch(benchmark::State& state) {
+  Skiplist<int> integers(16, default_compare<int>, RandomLevelPolicy<>(1));
+  std::vector<int> integer_keys;
+  for (int i = 0; i < state.range(0); ++i) {
+    integer_keys.push_back(rand());
+    integers.Insert(integer_keys.back());
+  }
+  std::ostringstream out;
+  FrozenSkiplist<int>::Write(integers, out);
+  const std::string data = out.str();
+  std::vector<uint64_t> words((data.size() + 7) / 8);
+  memcpy(words.data(), data.data(), data.size());
+  FrozenSkiplist<int> frozen(words.data(), data.size());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(frozen.Contains(integer_keys[rand() % integer_keys.size()]));
+  }
+}
+
 static void Update(benchmark::State& state) {
   for (auto _ : state) {
     bool exist = rand() % 2 == 1;
@@ -99,6 +279,15 @@ static void GetElementsByRange(benchmark::State& state) {
   }
 }
 
+static void RankRange(benchmark::State& state) {
+  for (auto _ : state) {
+    int start = rand() % skiplist.Size();
+    for (const std::string& key : skiplist.RankRange(start, start + 9)) {
+      benchmark::DoNotOptimize(key.data());
+    }
+  }
+}
+
 static void GetElementsByRevRange(benchmark::State& state) {
   for (auto _ : state) {
     skiplist.GetElementsByRevRange(rand() % keys.size(), rand() % (keys.size() + 1));
@@ -125,12 +314,25 @@ static void GetElementsInRange(benchmark::State& state) {
 }
 
 BENCHMARK(Insert);
+BENCHMARK(ArenaInsert);
+BENCHMARK(BulkLoad)->Arg(1 << 20);
+BENCHMARK(InsertBatch)->Arg(1 << 16);
+BENCHMARK(ConcurrentInsertAndSearch)->Threads(1)->Threads(4);
 BENCHMARK(Search);
+BENCHMARK(SearchDefaultCompare)->Arg(1 << 20);
+BENCHMARK(SearchPrefixCompare)->Arg(1 << 20);
+BENCHMARK(SearchIndex)->Args({1 << 20, 0})->Args({1 << 20, 1});
+BENCHMARK(SearchMany)->Args({1 << 22, 0})->Args({1 << 22, 1});
+BENCHMARK(Intersect)->Args({1 << 20, 1 << 20})->Args({1 << 20, 1 << 10});
+BENCHMARK(MergeMany)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK(LoadSnapshot)->Arg(1 << 20);
+BENCHMARK(FrozenSearch)->Arg(1 << 20);
 BENCHMARK(Update);
 BENCHMARK(Delete);
 BENCHMARK(GetElementByRank);
 BENCHMARK(GetRankOfElement);
 BENCHMARK(GetElementsByRange);
+BENCHMARK(RankRange);
 BENCHMARK(GetElementsByRevRange);
 BENCHMARK(GetElementsGt);
 BENCHMARK(GetElementsLt);
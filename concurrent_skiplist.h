@@ -0,0 +1,373 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+
+#include "epoch.h"
+#include "level_policy.h"
+#include "skiplist.h"
+
+namespace skiplist {
+
+/*
+ * ConcurrentSkiplist is a lock-free skiplist set.
+ *
+ * Insert, Delete and Contains may be called from any number of threads without external
+ * synchronization. Nodes are linked with CAS on each level, a node is deleted by first marking
+ * the low bit of its next pointers and then unlinking it, and unlinked nodes are reclaimed through
+ * epoch based reclamation (see epoch.h).
+ *
+ * Node levels are drawn by LevelPolicy like in Skiplist, whose MaxLevel bounds the height of the
+ * skiplist. Every thread draws levels from its own default-constructed policy, so that inserting
+ * threads never share its state.
+ *
+ * Unlike Skiplist, no span is maintained, so rank based queries are not supported.
+ */
+template <typename Key, typename Comparator = decltype(default_compare<Key>),
+          typename LevelPolicy = RandomLevelPolicy<>>
+class ConcurrentSkiplist {
+ private:
+  struct SkiplistNode;
+
+ public:
+  class Iterator;
+  ConcurrentSkiplist();
+  explicit ConcurrentSkiplist(const Comparator& compare);
+  ConcurrentSkiplist(const ConcurrentSkiplist&) = delete;
+  ConcurrentSkiplist& operator=(const ConcurrentSkiplist&) = delete;
+  Iterator Begin() const;
+  Iterator End() const;
+  bool Insert(const Key& key);
+  bool Contains(const Key& key) const;
+  bool Delete(const Key& key);
+  /* exact only when there is no concurrent writer */
+  size_t Size() const { return size_.load(std::memory_order_relaxed); }
+  ~ConcurrentSkiplist();
+
+ private:
+  static constexpr const int MaxSkiplistLevel = LevelPolicy::MaxLevel;
+  static_assert(MaxSkiplistLevel >= 1 && MaxSkiplistLevel <= UINT8_MAX,
+                "node levels are stored in a byte");
+  static size_t RandomLevel();
+  static bool IsMarked(uintptr_t p) { return p & 1; }
+  static SkiplistNode* GetPointer(uintptr_t p) { return reinterpret_cast<SkiplistNode*>(p & ~1); }
+  static uintptr_t Unmark(const SkiplistNode* node) { return reinterpret_cast<uintptr_t>(node); }
+  bool Lt(const Key& k1, const Key& k2) const { return compare_(k1, k2) < 0; }
+  bool Eq(const Key& k1, const Key& k2) const { return compare_(k1, k2) == 0; }
+  bool Find(const Key& key, SkiplistNode* preds[MaxSkiplistLevel],
+            SkiplistNode* succs[MaxSkiplistLevel]);
+  SkiplistNode* head_;
+  const Comparator compare_;
+  std::atomic<size_t> level_;
+  std::atomic<size_t> size_;
+};
+
+/*
+ * SkiplistNode
+ *
+ * next_ holds `level` tagged pointers. The low bit of next_[i] is set once the node is logically
+ * deleted in level i, after which the pointer is never changed again.
+ *
+ * The inserting thread may still be linking the upper levels of a node when another thread
+ * deletes it, so the node is retired only once both threads have unlinked it.
+ */
+template <typename Key, typename Comparator, typename LevelPolicy>
+struct ConcurrentSkiplist<Key, Comparator, LevelPolicy>::SkiplistNode {
+  static SkiplistNode* CreateSkiplistNode(const Key& key, size_t level);
+  static SkiplistNode* CreateSkiplistNode(size_t level);
+  static void DestroySkiplistNode(void* node);
+  uintptr_t LoadNext(size_t level) const { return next_[level].load(std::memory_order_acquire); }
+  bool CasNext(size_t level, uintptr_t expected, uintptr_t next) {
+    return next_[level].compare_exchange_strong(expected, next, std::memory_order_acq_rel,
+                                                std::memory_order_acquire);
+  }
+  /* Unref returns true once both the inserting and the deleting thread are done with the node */
+  bool Unref() { return refs_.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+  Key key_;
+  uint8_t level_;
+  /* held by the inserting thread and by the thread deleting the node */
+  std::atomic<uint8_t> refs_;
+  std::atomic<uintptr_t> next_[1];
+
+ private:
+  explicit SkiplistNode(size_t level) : level_(level), refs_(2){};
+  explicit SkiplistNode(const Key& key, size_t level) : key_(key), level_(level), refs_(2){};
+  static void* Allocate(size_t level);
+  void InitLevels();
+};
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+void* ConcurrentSkiplist<Key, Comparator, LevelPolicy>::SkiplistNode::Allocate(size_t level) {
+  return ::operator new(sizeof(SkiplistNode) + sizeof(std::atomic<uintptr_t>) * (level - 1));
+}
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+void ConcurrentSkiplist<Key, Comparator, LevelPolicy>::SkiplistNode::InitLevels() {
+  for (int i = 1; i < level_; ++i) {
+    new (&next_[i]) std::atomic<uintptr_t>();
+  }
+  for (int i = 0; i < level_; ++i) {
+    next_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+typename ConcurrentSkiplist<Key, Comparator, LevelPolicy>::SkiplistNode*
+ConcurrentSkiplist<Key, Comparator, LevelPolicy>::SkiplistNode::CreateSkiplistNode(const Key& key,
+                                                                      size_t level) {
+  void* mem = Allocate(level);
+  SkiplistNode* n;
+  try {
+    n = new (mem) SkiplistNode(key, level);
+  } catch (...) {
+    ::operator delete(mem);
+    throw;
+  }
+  n->InitLevels();
+  return n;
+}
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+typename ConcurrentSkiplist<Key, Comparator, LevelPolicy>::SkiplistNode*
+ConcurrentSkiplist<Key, Comparator, LevelPolicy>::SkiplistNode::CreateSkiplistNode(size_t level) {
+  void* mem = Allocate(level);
+  SkiplistNode* n;
+  try {
+    n = new (mem) SkiplistNode(level);
+  } catch (...) {
+    ::operator delete(mem);
+    throw;
+  }
+  n->InitLevels();
+  return n;
+}
+
+/* takes a void* so that it can be used as an epoch deleter */
+template <typename Key, typename Comparator, typename LevelPolicy>
+void ConcurrentSkiplist<Key, Comparator, LevelPolicy>::SkiplistNode::DestroySkiplistNode(
+    void* node) {
+  static_cast<SkiplistNode*>(node)->~SkiplistNode();
+  ::operator delete(node);
+}
+
+/*
+ * Iterator
+ *
+ * The iterator stays inside an epoch critical section for its lifetime, so the node it points to
+ * is never freed under it. Logically deleted nodes are skipped.
+ */
+template <typename Key, typename Comparator, typename LevelPolicy>
+class ConcurrentSkiplist<Key, Comparator, LevelPolicy>::Iterator {
+ public:
+  explicit Iterator(const SkiplistNode* node) : node_(node) {}
+  void operator++();
+  bool operator==(const Iterator& it) const { return node_ == it.node_; }
+  bool operator!=(const Iterator& it) const { return node_ != it.node_; }
+  const Key& operator*() const { return node_->key_; }
+
+ private:
+  static const SkiplistNode* SkipDeleted(const SkiplistNode* node);
+  friend class ConcurrentSkiplist;
+  EpochGuard guard_;
+  const SkiplistNode* node_;
+};
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+const typename ConcurrentSkiplist<Key, Comparator, LevelPolicy>::SkiplistNode*
+ConcurrentSkiplist<Key, Comparator, LevelPolicy>::Iterator::SkipDeleted(const SkiplistNode* node) {
+  while (node && IsMarked(node->LoadNext(0))) {
+    node = GetPointer(node->LoadNext(0));
+  }
+  return node;
+}
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+void ConcurrentSkiplist<Key, Comparator, LevelPolicy>::Iterator::operator++() {
+  node_ = SkipDeleted(GetPointer(node_->LoadNext(0)));
+}
+
+/* ConcurrentSkiplist */
+template <typename Key, typename Comparator, typename LevelPolicy>
+ConcurrentSkiplist<Key, Comparator, LevelPolicy>::ConcurrentSkiplist()
+    : head_(SkiplistNode::CreateSkiplistNode(MaxSkiplistLevel)),
+      compare_(default_compare<Key>),
+      level_(1),
+      size_(0) {}
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+ConcurrentSkiplist<Key, Comparator, LevelPolicy>::ConcurrentSkiplist(const Comparator& compare)
+    : head_(SkiplistNode::CreateSkiplistNode(MaxSkiplistLevel)),
+      compare_(compare),
+      level_(1),
+      size_(0) {}
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+typename ConcurrentSkiplist<Key, Comparator, LevelPolicy>::Iterator
+ConcurrentSkiplist<Key, Comparator, LevelPolicy>::Begin() const {
+  /* enter the critical section before the first node is read */
+  Iterator it(nullptr);
+  it.node_ = Iterator::SkipDeleted(GetPointer(head_->LoadNext(0)));
+  return it;
+}
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+typename ConcurrentSkiplist<Key, Comparator, LevelPolicy>::Iterator
+ConcurrentSkiplist<Key, Comparator, LevelPolicy>::End() const {
+  return Iterator(nullptr);
+}
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+size_t ConcurrentSkiplist<Key, Comparator, LevelPolicy>::RandomLevel() {
+  thread_local LevelPolicy level_policy;
+  return level_policy.RandomLevel();
+}
+
+/*
+ * Get the last node with a key less than the given key and its successor in each level below
+ * the current level, unlinking every logically deleted node met on the way.
+ * return true if a node with the key exists.
+ */
+template <typename Key, typename Comparator, typename LevelPolicy>
+bool ConcurrentSkiplist<Key, Comparator, LevelPolicy>::Find(const Key& key,
+                                               SkiplistNode* preds[MaxSkiplistLevel],
+                                               SkiplistNode* succs[MaxSkiplistLevel]) {
+retry:
+  SkiplistNode* pred = head_;
+  SkiplistNode* curr = nullptr;
+  for (int i = static_cast<int>(level_.load(std::memory_order_relaxed)) - 1; i >= 0; --i) {
+    curr = GetPointer(pred->LoadNext(i));
+    while (curr) {
+      uintptr_t succ = curr->LoadNext(i);
+      while (IsMarked(succ)) {
+        /* curr is deleted, unlink it */
+        if (!pred->CasNext(i, Unmark(curr), Unmark(GetPointer(succ)))) goto retry;
+        curr = GetPointer(succ);
+        if (!curr) break;
+        succ = curr->LoadNext(i);
+      }
+      if (curr && Lt(curr->key_, key)) {
+        pred = curr;
+        curr = GetPointer(succ);
+      } else {
+        break;
+      }
+    }
+    preds[i] = pred;
+    succs[i] = curr;
+  }
+  return curr && Eq(curr->key_, key);
+}
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+bool ConcurrentSkiplist<Key, Comparator, LevelPolicy>::Insert(const Key& key) {
+  EpochGuard guard;
+  SkiplistNode* preds[MaxSkiplistLevel];
+  SkiplistNode* succs[MaxSkiplistLevel];
+  size_t insert_level = RandomLevel();
+  SkiplistNode* node = nullptr;
+
+  /* raise the level first, so that Find returns the neighbours of every level of the node */
+  size_t level = level_.load(std::memory_order_relaxed);
+  while (level < insert_level && !level_.compare_exchange_weak(level, insert_level)) {
+  }
+
+  /* link level 0 first, which makes the key visible */
+  while (true) {
+    if (Find(key, preds, succs)) {
+      if (node) SkiplistNode::DestroySkiplistNode(node);
+      return false;
+    }
+    if (!node) node = SkiplistNode::CreateSkiplistNode(key, insert_level);
+    for (size_t i = 0; i < insert_level; ++i) {
+      node->next_[i].store(Unmark(succs[i]), std::memory_order_relaxed);
+    }
+    if (preds[0]->CasNext(0, Unmark(succs[0]), Unmark(node))) break;
+  }
+  size_.fetch_add(1, std::memory_order_relaxed);
+
+  /* then link the upper levels, giving up as soon as the node is being deleted */
+  bool linking = true;
+  for (size_t i = 1; linking && i < insert_level; ++i) {
+    while (true) {
+      uintptr_t next = node->LoadNext(i);
+      if (IsMarked(next)) {
+        linking = false;
+        break;
+      }
+      if (GetPointer(next) != succs[i] && !node->CasNext(i, next, Unmark(succs[i]))) continue;
+      if (preds[i]->CasNext(i, Unmark(succs[i]), Unmark(node))) break;
+      if (!Find(key, preds, succs) || succs[0] != node) {
+        linking = false;
+        break;
+      }
+    }
+  }
+
+  if (IsMarked(node->LoadNext(0))) {
+    /* deleted while being linked, unlink the levels linked after the deleting thread's search */
+    Find(key, preds, succs);
+  }
+  if (node->Unref()) Epoch::Retire(node, SkiplistNode::DestroySkiplistNode);
+  return true;
+}
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+bool ConcurrentSkiplist<Key, Comparator, LevelPolicy>::Contains(const Key& key) const {
+  EpochGuard guard;
+  const SkiplistNode* pred = head_;
+  const SkiplistNode* curr = nullptr;
+  for (int i = static_cast<int>(level_.load(std::memory_order_relaxed)) - 1; i >= 0; --i) {
+    curr = GetPointer(pred->LoadNext(i));
+    while (curr) {
+      uintptr_t succ = curr->LoadNext(i);
+      if (!IsMarked(succ) && !Lt(curr->key_, key)) break;
+      if (!IsMarked(succ)) pred = curr;
+      curr = GetPointer(succ);
+    }
+  }
+  return curr && Eq(curr->key_, key);
+}
+
+template <typename Key, typename Comparator, typename LevelPolicy>
+bool ConcurrentSkiplist<Key, Comparator, LevelPolicy>::Delete(const Key& key) {
+  EpochGuard guard;
+  SkiplistNode* preds[MaxSkiplistLevel];
+  SkiplistNode* succs[MaxSkiplistLevel];
+  if (!Find(key, preds, succs)) return false;
+
+  /* mark the upper levels top down, then level 0 which decides who deletes the node */
+  SkiplistNode* node = succs[0];
+  for (int i = node->level_ - 1; i >= 1; --i) {
+    uintptr_t next = node->LoadNext(i);
+    while (!IsMarked(next) && !node->CasNext(i, next, next | 1)) {
+      next = node->LoadNext(i);
+    }
+  }
+
+  uintptr_t next = node->LoadNext(0);
+  while (true) {
+    if (IsMarked(next)) return false;
+    if (node->CasNext(0, next, next | 1)) break;
+    next = node->LoadNext(0);
+  }
+  size_.fetch_sub(1, std::memory_order_relaxed);
+
+  /* unlink the node from every level */
+  Find(key, preds, succs);
+  if (node->Unref()) Epoch::Retire(node, SkiplistNode::DestroySkiplistNode);
+  return true;
+}
+
+/* the caller must make sure no other thread is still using the skiplist */
+template <typename Key, typename Comparator, typename LevelPolicy>
+ConcurrentSkiplist<Key, Comparator, LevelPolicy>::~ConcurrentSkiplist() {
+  SkiplistNode* node = head_;
+  while (node) {
+    uintptr_t next = node->LoadNext(0);
+    SkiplistNode::DestroySkiplistNode(node);
+    node = GetPointer(next);
+  }
+}
+
+}  // namespace skiplist
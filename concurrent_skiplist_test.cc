@@ -0,0 +1,131 @@
+#include "concurrent_skiplist.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace skiplist {
+TEST(ConcurrentSkiplistTest, Basic) {
+  ConcurrentSkiplist<std::string> skiplist;
+  ASSERT_TRUE(skiplist.Insert("key1"));
+  ASSERT_TRUE(skiplist.Insert("key2"));
+  ASSERT_TRUE(skiplist.Insert("key0"));
+  ASSERT_FALSE(skiplist.Insert("key1"));
+  ASSERT_EQ(skiplist.Size(), 3);
+
+  ASSERT_TRUE(skiplist.Contains("key0"));
+  ASSERT_TRUE(skiplist.Contains("key1"));
+  ASSERT_FALSE(skiplist.Contains("key_not_exist"));
+
+  ASSERT_TRUE(skiplist.Delete("key1"));
+  ASSERT_FALSE(skiplist.Delete("key1"));
+  ASSERT_FALSE(skiplist.Contains("key1"));
+  ASSERT_EQ(skiplist.Size(), 2);
+
+  std::vector<std::string> keys;
+  for (auto it = skiplist.Begin(); it != skiplist.End(); ++it) {
+    keys.push_back(*it);
+  }
+  ASSERT_EQ(keys, std::vector<std::string>({"key0", "key2"}));
+}
+
+TEST(ConcurrentSkiplistTest, ConcurrentInsertAndDelete) {
+  const int thread_count = 8, keys_per_thread = 2000;
+  ConcurrentSkiplist<int> skiplist;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&skiplist, t]() {
+      for (int i = 0; i < keys_per_thread; ++i) {
+        skiplist.Insert(i * thread_count + t);
+      }
+      /* every thread deletes the odd keys inserted by itself */
+      for (int i = 1; i < keys_per_thread; i += 2) {
+        EXPECT_TRUE(skiplist.Delete(i * thread_count + t));
+      }
+    });
+  }
+  /* readers run concurrently with the writers */
+  for (int t = 0; t < 2; ++t) {
+    threads.emplace_back([&skiplist]() {
+      for (int round = 0; round < 10; ++round) {
+        int prev = -1;
+        for (auto it = skiplist.Begin(); it != skiplist.End(); ++it) {
+          EXPECT_LT(prev, *it);
+          prev = *it;
+        }
+        skiplist.Contains(round);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(skiplist.Size(), thread_count * keys_per_thread / 2);
+  for (int i = 0; i < keys_per_thread; ++i) {
+    for (int t = 0; t < thread_count; ++t) {
+      ASSERT_EQ(skiplist.Contains(i * thread_count + t), i % 2 == 0);
+    }
+  }
+}
+
+TEST(ConcurrentSkiplistTest, ConcurrentSameKeys) {
+  ConcurrentSkiplist<int> skiplist;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&skiplist]() {
+      for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < 32; ++i) {
+          skiplist.Insert(i);
+        }
+        for (int i = 0; i < 32; ++i) {
+          skiplist.Delete(i);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(skiplist.Size(), 0);
+  ASSERT_TRUE(skiplist.Begin() == skiplist.End());
+}
+
+TEST(ConcurrentSkiplistTest, LevelPolicy) {
+  /* more keys than the 2^16 that used to be the fixed limit, with a policy of 4^12 keys */
+  using Policy = RandomLevelPolicy<4, 12>;
+  const int thread_count = 4, keys_per_thread = 1 << 15;
+  ConcurrentSkiplist<int, decltype(default_compare<int>), Policy> skiplist;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&skiplist, t]() {
+      for (int i = 0; i < keys_per_thread; ++i) {
+        skiplist.Insert(i * thread_count + t);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(skiplist.Size(), thread_count * keys_per_thread);
+  for (int i = 0; i < thread_count * keys_per_thread; ++i) {
+    ASSERT_TRUE(skiplist.Contains(i));
+  }
+  ASSERT_FALSE(skiplist.Contains(-1));
+  for (int i = 0; i < thread_count * keys_per_thread; i += 2) {
+    ASSERT_TRUE(skiplist.Delete(i));
+  }
+  int expected = 1;
+  for (auto it = skiplist.Begin(); it != skiplist.End(); ++it, expected += 2) {
+    ASSERT_EQ(*it, expected);
+  }
+  ASSERT_EQ(expected, thread_count * keys_per_thread + 1);
+}
+}  // namespace skiplist
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace skiplist {
+
+/*
+ * Epoch based reclamation.
+ *
+ * A thread reading shared nodes stays inside a critical section, delimited by an EpochGuard, for
+ * as long as it holds references to them. A node unlinked by a writer is handed to Retire()
+ * instead of being freed, and is only freed once the global epoch has advanced twice since. The
+ * epoch only advances when every thread inside a critical section has observed the current one,
+ * so two advances guarantee that no thread can still reach the node.
+ *
+ * Critical sections may be nested. All skiplists share one epoch domain.
+ */
+class Epoch {
+ public:
+  using Deleter = void (*)(void*);
+  static void Enter();
+  static void Exit();
+  static void Retire(void* p, Deleter deleter);
+  static void Collect();
+  static bool TryAdvance();
+  static uint64_t Current() { return GetDomain().epoch_.load(std::memory_order_seq_cst); }
+  /* whether memory unlinked during the given epoch can be freed */
+  static bool Expired(uint64_t epoch) { return epoch + 2 <= Current(); }
+
+ private:
+  static constexpr const size_t CollectThreshold = 64;
+  struct Retired {
+    void* p_;
+    Deleter deleter_;
+    uint64_t epoch_;
+  };
+  struct ThreadRecord {
+    /* (epoch << 1) | 1 while inside a critical section, 0 otherwise */
+    std::atomic<uint64_t> state_{0};
+    std::atomic<bool> in_use_{true};
+    ThreadRecord* next_ = nullptr;
+    size_t nesting_ = 0;
+    std::vector<Retired> retired_;
+  };
+  struct Domain {
+    std::atomic<uint64_t> epoch_{2};
+    std::atomic<ThreadRecord*> records_{nullptr};
+    /* nodes left behind by exited threads */
+    std::mutex orphans_mutex_;
+    std::vector<Retired> orphans_;
+  };
+  struct LocalRecord {
+    LocalRecord();
+    ~LocalRecord();
+    ThreadRecord* record_;
+  };
+  static Domain& GetDomain();
+  static ThreadRecord* GetLocalRecord();
+  static void FreeExpired(std::vector<Retired>& retired, uint64_t epoch);
+};
+
+/*
+ * EpochGuard keeps the current thread inside a critical section for its lifetime.
+ * A guard constructed with enter set to false does nothing.
+ */
+class EpochGuard {
+ public:
+  explicit EpochGuard(bool enter = true) : entered_(enter) {
+    if (entered_) Epoch::Enter();
+  }
+  EpochGuard(const EpochGuard& guard) : EpochGuard(guard.entered_) {}
+  EpochGuard& operator=(const EpochGuard& guard) {
+    if (guard.entered_ && !entered_) Epoch::Enter();
+    if (!guard.entered_ && entered_) Epoch::Exit();
+    entered_ = guard.entered_;
+    return *this;
+  }
+  ~EpochGuard() {
+    if (entered_) Epoch::Exit();
+  }
+
+ private:
+  bool entered_;
+};
+
+inline void Epoch::Enter() {
+  ThreadRecord* record = GetLocalRecord();
+  if (record->nesting_++ > 0) return;
+
+  uint64_t epoch = GetDomain().epoch_.load(std::memory_order_relaxed);
+  record->state_.store((epoch << 1) | 1, std::memory_order_relaxed);
+  /* make the record visible before any shared node is read */
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+inline void Epoch::Exit() {
+  ThreadRecord* record = GetLocalRecord();
+  if (--record->nesting_ > 0) return;
+  record->state_.store(0, std::memory_order_release);
+}
+
+/*
+ * the node must already be unreachable for threads entering a critical section from now on.
+ */
+inline void Epoch::Retire(void* p, Deleter deleter) {
+  ThreadRecord* record = GetLocalRecord();
+  record->retired_.push_back({p, deleter, Current()});
+  if (record->retired_.size() >= CollectThreshold) {
+    Collect();
+  }
+}
+
+/* try to advance the epoch and free every retired node that has expired */
+inline void Epoch::Collect() {
+  Domain& domain = GetDomain();
+  TryAdvance();
+  uint64_t epoch = domain.epoch_.load(std::memory_order_acquire);
+
+  FreeExpired(GetLocalRecord()->retired_, epoch);
+
+  std::unique_lock<std::mutex> lock(domain.orphans_mutex_, std::try_to_lock);
+  if (lock.owns_lock()) {
+    FreeExpired(domain.orphans_, epoch);
+  }
+}
+
+inline bool Epoch::TryAdvance() {
+  Domain& domain = GetDomain();
+  uint64_t epoch = domain.epoch_.load(std::memory_order_seq_cst);
+  for (ThreadRecord* r = domain.records_.load(std::memory_order_acquire); r; r = r->next_) {
+    uint64_t state = r->state_.load(std::memory_order_seq_cst);
+    if ((state & 1) && (state >> 1) != epoch) return false;
+  }
+  return domain.epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+}
+
+inline void Epoch::FreeExpired(std::vector<Retired>& retired, uint64_t epoch) {
+  size_t kept = 0;
+  for (size_t i = 0; i < retired.size(); ++i) {
+    if (retired[i].epoch_ + 2 <= epoch) {
+      retired[i].deleter_(retired[i].p_);
+    } else {
+      retired[kept++] = retired[i];
+    }
+  }
+  retired.resize(kept);
+}
+
+/* the domain is never destroyed, so that threads exiting late can still use it */
+inline Epoch::Domain& Epoch::GetDomain() {
+  static Domain* domain = new Domain();
+  return *domain;
+}
+
+inline Epoch::ThreadRecord* Epoch::GetLocalRecord() {
+  thread_local LocalRecord local;
+  return local.record_;
+}
+
+/* reuse the record of an exited thread if possible, otherwise publish a new one */
+inline Epoch::LocalRecord::LocalRecord() {
+  Domain& domain = GetDomain();
+  for (ThreadRecord* r = domain.records_.load(std::memory_order_acquire); r; r = r->next_) {
+    bool in_use = false;
+    if (!r->in_use_.load(std::memory_order_relaxed) &&
+        r->in_use_.compare_exchange_strong(in_use, true, std::memory_order_acquire)) {
+      record_ = r;
+      return;
+    }
+  }
+
+  record_ = new ThreadRecord();
+  ThreadRecord* head = domain.records_.load(std::memory_order_relaxed);
+  do {
+    record_->next_ = head;
+  } while (!domain.records_.compare_exchange_weak(head, record_, std::memory_order_release,
+                                                  std::memory_order_relaxed));
+}
+
+/* hand the nodes that have not expired yet over to the other threads */
+inline Epoch::LocalRecord::~LocalRecord() {
+  Domain& domain = GetDomain();
+  {
+    std::lock_guard<std::mutex> lock(domain.orphans_mutex_);
+    domain.orphans_.insert(domain.orphans_.end(), record_->retired_.begin(),
+                           record_->retired_.end());
+  }
+  record_->retired_.clear();
+  record_->nesting_ = 0;
+  record_->state_.store(0, std::memory_order_relaxed);
+  record_->in_use_.store(false, std::memory_order_release);
+}
+
+}  // namespace skiplist
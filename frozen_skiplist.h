@@ -0,0 +1,455 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "skiplist.h"
+
+namespace skiplist {
+
+/*
+ * FrozenSkiplist is an immutable skiplist read directly from a flat file, without deserializing
+ * it.
+ *
+ * Write lays the keys of a Skiplist out in one file, in order, each node holding its key and its
+ * tower of next/span pairs. Next pointers are offsets from the start of the file, so the file can
+ * be mapped at any address and queried in place: opening a frozen skiplist only checks its
+ * header, and processes mapping the same file share one copy of it in the page cache. Node levels
+ * are derived from their rank like in a balanced BulkLoad, so that the towers are evenly spread.
+ *
+ * Keys are stored as their raw bytes, so they must be trivially copyable, and the file can only
+ * be read on a platform with the same byte order and key layout, which the header records.
+ * Every offset followed is checked to point forward and inside the file, so a corrupted file
+ * throws std::invalid_argument instead of reading out of bounds.
+ */
+template <typename Key, typename Comparator = decltype(default_compare<Key>)>
+class FrozenSkiplist {
+ public:
+  class Iterator;
+  /* query `size` bytes at `data`, written by Write and aligned to 8 bytes, without copying them */
+  FrozenSkiplist(const void* data, size_t size);
+  FrozenSkiplist(const void* data, size_t size, const Comparator& compare);
+  FrozenSkiplist(const FrozenSkiplist&) = delete;
+  FrozenSkiplist& operator=(const FrozenSkiplist&) = delete;
+  FrozenSkiplist(FrozenSkiplist&& skiplist);
+  /* map the file at `path` read-only */
+  static FrozenSkiplist Open(const std::string& path);
+  static FrozenSkiplist Open(const std::string& path, const Comparator& compare);
+  template <typename Allocator, typename LevelPolicy>
+  static void Write(const Skiplist<Key, Comparator, Allocator, LevelPolicy>& skiplist,
+                    std::ostream& out);
+  Iterator Begin() const;
+  Iterator End() const;
+  Iterator begin() const { return Begin(); }
+  Iterator end() const { return End(); }
+  Iterator LowerBound(const Key& key) const;
+  Iterator UpperBound(const Key& key) const;
+  bool Contains(const Key& key) const;
+  ssize_t GetRankofElement(const Key& key) const;
+  const Key& GetElementByRank(int rank) const;
+  template <typename Visitor>
+  void ForEachInRange(const Key& start, const Key& end, Visitor visit) const;
+  size_t Size() const { return size_; }
+  ~FrozenSkiplist();
+
+ private:
+  static_assert(std::is_trivially_copyable<Key>::value,
+                "frozen keys are stored as their bytes and must be trivially copyable");
+  static_assert(alignof(Key) <= sizeof(uint64_t), "frozen keys must be aligned to 8 bytes or less");
+  static constexpr const uint32_t Version = 1;
+  /* written in native byte order, to tell files written with another byte order */
+  static constexpr const uint32_t ByteOrder = 0x01020304;
+  static constexpr const size_t Branching = 4;
+  static constexpr const size_t MaxLevel = 32;
+  /* the key is padded so that the towers are aligned to 8 bytes */
+  static constexpr const size_t KeySize = (sizeof(Key) + 7) / 8 * 8;
+  /* a node is its level, its key, then `level` next/span pairs */
+  static constexpr const size_t NodeHeaderSize = sizeof(uint64_t) + KeySize;
+  static constexpr const size_t LevelSize = 2 * sizeof(uint64_t);
+  struct Header;
+  static size_t NodeSize(size_t level) { return NodeHeaderSize + level * LevelSize; }
+  static size_t Levels(size_t count);
+  static size_t NodeOffset(size_t rank, size_t levels);
+  static size_t BalancedLevel(size_t rank);
+  uint64_t Load(size_t offset) const;
+  const Key& KeyAt(size_t node) const;
+  size_t GetNext(size_t node, size_t level) const;
+  size_t GetSpan(size_t node, size_t level) const {
+    return Load(node + NodeHeaderSize + level * LevelSize + sizeof(uint64_t));
+  }
+  template <bool Inclusive>
+  size_t FindLast(const Key& key, size_t* rank) const;
+  const char* data_;
+  size_t bytes_;
+  /* the size of the mapping to unmap, or 0 if the bytes are owned by the caller */
+  size_t mapped_;
+  size_t size_;
+  size_t level_;
+  const Comparator compare_;
+};
+
+/*
+ * Header
+ *
+ * The file starts with the header, followed by the head node, which has `level` levels, then the
+ * nodes in order. An offset of 0 marks the end of a level.
+ */
+template <typename Key, typename Comparator>
+struct FrozenSkiplist<Key, Comparator>::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t key_size;
+  uint32_t level;
+  uint64_t count;
+  /* the size of the whole file */
+  uint64_t size;
+};
+
+/*
+ * Iterator
+ *
+ * A standard forward iterator over the keys, which are read from the file in place.
+ */
+template <typename Key, typename Comparator>
+class FrozenSkiplist<Key, Comparator>::Iterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Key;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const Key*;
+  using reference = const Key&;
+
+  Iterator() : skiplist_(nullptr), node_(0) {}
+  explicit Iterator(const FrozenSkiplist* skiplist, size_t node)
+      : skiplist_(skiplist), node_(node) {}
+  Iterator& operator++() {
+    node_ = skiplist_->GetNext(node_, 0);
+    return *this;
+  }
+  Iterator operator++(int) {
+    Iterator it(*this);
+    ++(*this);
+    return it;
+  }
+  bool operator==(const Iterator& it) const {
+    return skiplist_ == it.skiplist_ && node_ == it.node_;
+  }
+  bool operator!=(const Iterator& it) const { return !((*this) == it); }
+  const Key& operator*() const { return skiplist_->KeyAt(node_); }
+  const Key* operator->() const { return &skiplist_->KeyAt(node_); }
+
+ private:
+  const FrozenSkiplist* skiplist_;
+  /* the offset of the node, 0 past the last one */
+  size_t node_;
+};
+
+namespace frozen_internal {
+constexpr const char Magic[8] = {'S', 'K', 'I', 'P', 'F', 'R', 'O', 'Z'};
+}  // namespace frozen_internal
+
+template <typename Key, typename Comparator>
+FrozenSkiplist<Key, Comparator>::FrozenSkiplist(const void* data, size_t size)
+    : FrozenSkiplist(data, size, default_compare<Key>) {}
+
+/* check the header and the head node, the other nodes are checked as they are reached */
+template <typename Key, typename Comparator>
+FrozenSkiplist<Key, Comparator>::FrozenSkiplist(const void* data, size_t size,
+                                                const Comparator& compare)
+    : data_(static_cast<const char*>(data)), bytes_(size), mapped_(0), compare_(compare) {
+  Header header;
+  if (size < sizeof(Header) || reinterpret_cast<uintptr_t>(data) % sizeof(uint64_t) != 0) {
+    throw std::invalid_argument("skiplist frozen file has no valid header");
+  }
+  memcpy(&header, data, sizeof(Header));
+  if (memcmp(header.magic, frozen_internal::Magic, sizeof(header.magic)) != 0 ||
+      header.version != Version || header.byte_order != ByteOrder ||
+      header.key_size != sizeof(Key)) {
+    throw std::invalid_argument("skiplist frozen file does not match the key type or version");
+  }
+  if (header.size != size || header.level < 1 || header.level > MaxLevel ||
+      size < sizeof(Header) + NodeSize(header.level) || Load(sizeof(Header)) != header.level) {
+    throw std::invalid_argument("skiplist frozen file is corrupted");
+  }
+  size_ = header.count;
+  level_ = header.level;
+}
+
+template <typename Key, typename Comparator>
+FrozenSkiplist<Key, Comparator>::FrozenSkiplist(FrozenSkiplist&& skiplist)
+    : data_(skiplist.data_),
+      bytes_(skiplist.bytes_),
+      mapped_(skiplist.mapped_),
+      size_(skiplist.size_),
+      level_(skiplist.level_),
+      compare_(skiplist.compare_) {
+  skiplist.mapped_ = 0;
+}
+
+template <typename Key, typename Comparator>
+FrozenSkiplist<Key, Comparator> FrozenSkiplist<Key, Comparator>::Open(const std::string& path) {
+  return Open(path, default_compare<Key>);
+}
+
+template <typename Key, typename Comparator>
+FrozenSkiplist<Key, Comparator> FrozenSkiplist<Key, Comparator>::Open(const std::string& path,
+                                                                      const Comparator& compare) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("skiplist could not open " + path);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("skiplist could not open " + path);
+  }
+  size_t size = st.st_size;
+  if (size < sizeof(Header)) {
+    close(fd);
+    throw std::invalid_argument("skiplist frozen file has no valid header");
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  /* the mapping stays valid once the file is closed */
+  close(fd);
+  if (data == MAP_FAILED) throw std::runtime_error("skiplist could not map " + path);
+  try {
+    FrozenSkiplist skiplist(data, size, compare);
+    skiplist.mapped_ = size;
+    return skiplist;
+  } catch (...) {
+    munmap(data, size);
+    throw;
+  }
+}
+
+/*
+ * write the keys of the skiplist to the stream in the frozen format. node levels and offsets only
+ * depend on the number of keys, so every next offset is known before its node is written and the
+ * file is written in a single pass.
+ */
+template <typename Key, typename Comparator>
+template <typename Allocator, typename LevelPolicy>
+void FrozenSkiplist<Key, Comparator>::Write(
+    const Skiplist<Key, Comparator, Allocator, LevelPolicy>& skiplist, std::ostream& out) {
+  const size_t count = skiplist.Size();
+  const size_t levels = Levels(count);
+
+  Header header;
+  memset(&header, 0, sizeof(Header));
+  memcpy(header.magic, frozen_internal::Magic, sizeof(header.magic));
+  header.version = Version;
+  header.byte_order = ByteOrder;
+  header.key_size = sizeof(Key);
+  header.level = levels;
+  header.count = count;
+  header.size = NodeOffset(count + 1, levels);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+  /* the node of rank r reaches level l if Branching^l divides r, the head reaches every level */
+  std::vector<char> node;
+  auto write_node = [&](size_t rank, size_t level, const Key* key) {
+    node.assign(NodeSize(level), 0);
+    uint64_t value = level;
+    memcpy(node.data(), &value, sizeof(uint64_t));
+    if (key) memcpy(node.data() + sizeof(uint64_t), key, sizeof(Key));
+    for (size_t i = 0, step = 1; i < level; ++i, step *= Branching) {
+      size_t next = (rank / step + 1) * step;
+      uint64_t pair[2] = {next <= count ? NodeOffset(next, levels) : 0,
+                          next <= count ? next - rank : 0};
+      memcpy(node.data() + NodeHeaderSize + i * LevelSize, pair, LevelSize);
+    }
+    out.write(node.data(), node.size());
+  };
+
+  write_node(0, levels, nullptr);
+  size_t rank = 0;
+  for (const Key& key : skiplist) {
+    ++rank;
+    write_node(rank, BalancedLevel(rank), &key);
+  }
+  out.flush();
+  if (!out || rank != count) throw std::runtime_error("skiplist frozen file write failed");
+}
+
+template <typename Key, typename Comparator>
+typename FrozenSkiplist<Key, Comparator>::Iterator FrozenSkiplist<Key, Comparator>::Begin() const {
+  return Iterator(this, GetNext(sizeof(Header), 0));
+}
+
+template <typename Key, typename Comparator>
+typename FrozenSkiplist<Key, Comparator>::Iterator FrozenSkiplist<Key, Comparator>::End() const {
+  return Iterator(this, 0);
+}
+
+/* return an iterator to the first key not less than the given key */
+template <typename Key, typename Comparator>
+typename FrozenSkiplist<Key, Comparator>::Iterator FrozenSkiplist<Key, Comparator>::LowerBound(
+    const Key& key) const {
+  size_t rank;
+  return Iterator(this, GetNext(FindLast<false>(key, &rank), 0));
+}
+
+/* return an iterator to the first key greater than the given key */
+template <typename Key, typename Comparator>
+typename FrozenSkiplist<Key, Comparator>::Iterator FrozenSkiplist<Key, Comparator>::UpperBound(
+    const Key& key) const {
+  size_t rank;
+  return Iterator(this, GetNext(FindLast<true>(key, &rank), 0));
+}
+
+template <typename Key, typename Comparator>
+bool FrozenSkiplist<Key, Comparator>::Contains(const Key& key) const {
+  size_t rank;
+  size_t next = GetNext(FindLast<false>(key, &rank), 0);
+  return next && compare_(KeyAt(next), key) == 0;
+}
+
+/* return the rank of the first key equal to the given key, or -1 if there is none */
+template <typename Key, typename Comparator>
+ssize_t FrozenSkiplist<Key, Comparator>::GetRankofElement(const Key& key) const {
+  size_t rank;
+  size_t next = GetNext(FindLast<false>(key, &rank), 0);
+  return next && compare_(KeyAt(next), key) == 0 ? rank : -1;
+}
+
+/* negative ranks count from the back like in Skiplist::GetElementByRank */
+template <typename Key, typename Comparator>
+const Key& FrozenSkiplist<Key, Comparator>::GetElementByRank(int rank) const {
+  if (rank < 0) rank += size_;
+  if (rank < 0 || static_cast<size_t>(rank) >= size_) {
+    throw std::out_of_range("skiplist index out of bound");
+  }
+
+  /* ranks count from 1 in spans, the head being rank 0 */
+  const size_t target = rank + 1;
+  size_t node = sizeof(Header);
+  size_t traversed = 0;
+  for (int i = level_ - 1; i >= 0; --i) {
+    size_t next = GetNext(node, i);
+    while (next && traversed + GetSpan(node, i) <= target) {
+      traversed += GetSpan(node, i);
+      node = next;
+      next = GetNext(node, i);
+    }
+  }
+  if (traversed != target) throw std::invalid_argument("skiplist frozen file is corrupted");
+  return KeyAt(node);
+}
+
+/* call visit(key) for every key within the range [start, end) in order, without copying them */
+template <typename Key, typename Comparator>
+template <typename Visitor>
+void FrozenSkiplist<Key, Comparator>::ForEachInRange(const Key& start, const Key& end,
+                                                     Visitor visit) const {
+  size_t rank;
+  size_t node = GetNext(FindLast<false>(start, &rank), 0);
+  while (node && compare_(KeyAt(node), end) < 0) {
+    visit(KeyAt(node));
+    node = GetNext(node, 0);
+  }
+}
+
+template <typename Key, typename Comparator>
+FrozenSkiplist<Key, Comparator>::~FrozenSkiplist() {
+  if (mapped_) munmap(const_cast<char*>(data_), mapped_);
+}
+
+/* the number of levels, such that the top level of the head reaches at least one node */
+template <typename Key, typename Comparator>
+size_t FrozenSkiplist<Key, Comparator>::Levels(size_t count) {
+  size_t levels = 1;
+  for (; levels < MaxLevel && count >= Branching; count /= Branching) {
+    ++levels;
+  }
+  return levels;
+}
+
+/*
+ * the offset of the node of the given rank, the head being rank 0. the nodes before it reach
+ * level l + 1 once every Branching^l ranks, which sums up their levels without visiting them.
+ */
+template <typename Key, typename Comparator>
+size_t FrozenSkiplist<Key, Comparator>::NodeOffset(size_t rank, size_t levels) {
+  size_t offset = sizeof(Header) + NodeSize(levels);
+  if (rank == 0) return sizeof(Header);
+  size_t nodes = rank - 1;
+  offset += nodes * NodeHeaderSize;
+  for (size_t i = 0, step = 1; i < levels; ++i, step *= Branching) {
+    offset += nodes / step * LevelSize;
+  }
+  return offset;
+}
+
+template <typename Key, typename Comparator>
+size_t FrozenSkiplist<Key, Comparator>::BalancedLevel(size_t rank) {
+  size_t level = 1;
+  while (level < MaxLevel && rank % Branching == 0) {
+    rank /= Branching;
+    ++level;
+  }
+  return level;
+}
+
+/* the file is aligned to 8 bytes and so is every field, see Header */
+template <typename Key, typename Comparator>
+uint64_t FrozenSkiplist<Key, Comparator>::Load(size_t offset) const {
+  return *reinterpret_cast<const uint64_t*>(data_ + offset);
+}
+
+template <typename Key, typename Comparator>
+const Key& FrozenSkiplist<Key, Comparator>::KeyAt(size_t node) const {
+  return *reinterpret_cast<const Key*>(data_ + node + sizeof(uint64_t));
+}
+
+/*
+ * return the offset of the next node in the level, or 0 at the end of the level. nodes are laid
+ * out in order, so a next offset must point forward, to a node with room for the level.
+ */
+template <typename Key, typename Comparator>
+size_t FrozenSkiplist<Key, Comparator>::GetNext(size_t node, size_t level) const {
+  uint64_t next = Load(node + NodeHeaderSize + level * LevelSize);
+  if (next && (next <= node || next % sizeof(uint64_t) != 0 ||
+               next > bytes_ - NodeSize(level + 1))) {
+    throw std::invalid_argument("skiplist frozen file is corrupted");
+  }
+  return next;
+}
+
+/*
+ * return the last node less than the key, or not greater than the key if Inclusive is set, and
+ * its rank.
+ */
+template <typename Key, typename Comparator>
+template <bool Inclusive>
+size_t FrozenSkiplist<Key, Comparator>::FindLast(const Key& key, size_t* rank) const {
+  size_t node = sizeof(Header);
+  *rank = 0;
+  /* the first node known to be past the key, which needs no comparison again */
+  size_t bound = 0;
+  for (int i = level_ - 1; i >= 0; --i) {
+    size_t next = GetNext(node, i);
+    while (next && next != bound) {
+      int cmp = compare_(KeyAt(next), key);
+      if (cmp > 0 || (cmp == 0 && !Inclusive)) break;
+      *rank += GetSpan(node, i);
+      node = next;
+      next = GetNext(node, i);
+    }
+    bound = next;
+  }
+  return node;
+}
+
+}  // namespace skiplist
@@ -0,0 +1,122 @@
+#include "frozen_skiplist.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "skiplist.h"
+
+namespace skiplist {
+/* copy the bytes of a frozen skiplist to memory aligned like a mapping */
+static std::vector<uint64_t> Freeze(const Skiplist<int>& skiplist) {
+  std::ostringstream out;
+  FrozenSkiplist<int>::Write(skiplist, out);
+  const std::string data = out.str();
+  std::vector<uint64_t> words((data.size() + 7) / 8);
+  memcpy(words.data(), data.data(), data.size());
+  return words;
+}
+
+TEST(FrozenSkiplistTest, Basic) {
+  /* sizes around the level boundaries */
+  for (int size : {0, 1, 3, 4, 5, 16, 17, 100, 1000}) {
+    Skiplist<int> skiplist;
+    for (int i = 0; i < size; ++i) {
+      skiplist.Insert(i * 2);
+    }
+    std::vector<uint64_t> words = Freeze(skiplist);
+    FrozenSkiplist<int> frozen(words.data(), words.size() * 8);
+    ASSERT_EQ(frozen.Size(), size);
+    ASSERT_EQ(std::vector<int>(frozen.begin(), frozen.end()), skiplist.GetElementsByRange(0, -1));
+
+    for (int i = -1; i <= size * 2; ++i) {
+      ASSERT_EQ(frozen.Contains(i), skiplist.Contains(i));
+      ASSERT_EQ(frozen.GetRankofElement(i), skiplist.GetRankofElement(i));
+      auto lower = frozen.LowerBound(i);
+      ASSERT_EQ(lower == frozen.End() ? -1 : *lower, i >= size * 2 - 1 ? -1 : (i + 1) / 2 * 2);
+      auto upper = frozen.UpperBound(i);
+      ASSERT_EQ(upper == frozen.End() ? -1 : *upper, i >= size * 2 - 2 ? -1 : (i + 2) / 2 * 2);
+    }
+    for (int rank = -size; rank < size; ++rank) {
+      ASSERT_EQ(frozen.GetElementByRank(rank), skiplist.GetElementByRank(rank));
+    }
+    ASSERT_THROW(frozen.GetElementByRank(size), std::out_of_range);
+    ASSERT_THROW(frozen.GetElementByRank(-size - 1), std::out_of_range);
+  }
+}
+
+TEST(FrozenSkiplistTest, Range) {
+  Skiplist<int> skiplist;
+  skiplist.EnableDuplicates();
+  for (int i = 0; i < 100; ++i) {
+    skiplist.Insert(i / 2);
+  }
+  std::vector<uint64_t> words = Freeze(skiplist);
+  FrozenSkiplist<int> frozen(words.data(), words.size() * 8);
+
+  std::vector<int> keys;
+  frozen.ForEachInRange(10, 13, [&keys](int key) { keys.push_back(key); });
+  ASSERT_EQ(keys, std::vector<int>({10, 10, 11, 11, 12, 12}));
+  /* the first of the equal keys */
+  ASSERT_EQ(frozen.GetRankofElement(10), 20);
+  ASSERT_EQ(*frozen.UpperBound(10), 11);
+}
+
+TEST(FrozenSkiplistTest, Open) {
+  /* fixed-size string keys */
+  using Name = std::array<char, 12>;
+  Skiplist<Name> skiplist;
+  for (int i = 0; i < 1000; ++i) {
+    Name name = {};
+    snprintf(name.data(), name.size(), "key%04d", i);
+    skiplist.Insert(name);
+  }
+  char path[] = "/tmp/frozen_skiplist_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  {
+    std::ofstream out(path, std::ios::binary);
+    FrozenSkiplist<Name>::Write(skiplist, out);
+  }
+
+  {
+    FrozenSkiplist<Name> frozen = FrozenSkiplist<Name>::Open(path);
+    ASSERT_EQ(frozen.Size(), 1000);
+    ASSERT_EQ(std::string(frozen.GetElementByRank(500).data()), "key0500");
+    ASSERT_EQ(frozen.GetRankofElement(skiplist.GetElementByRank(123)), 123);
+    /* a moved-from skiplist no longer owns the mapping */
+    FrozenSkiplist<Name> moved(std::move(frozen));
+    ASSERT_TRUE(moved.Contains(skiplist.GetElementByRank(999)));
+  }
+  /* a file written for another key type */
+  ASSERT_THROW(FrozenSkiplist<int>::Open(path), std::invalid_argument);
+  unlink(path);
+  ASSERT_THROW(FrozenSkiplist<int>::Open(path), std::runtime_error);
+}
+
+TEST(FrozenSkiplistTest, Corruption) {
+  Skiplist<int> skiplist;
+  for (int i = 0; i < 100; ++i) {
+    skiplist.Insert(i);
+  }
+  std::vector<uint64_t> words = Freeze(skiplist);
+  ASSERT_THROW(FrozenSkiplist<int>(words.data(), 16), std::invalid_argument);
+  ASSERT_THROW(FrozenSkiplist<int>(words.data(), words.size() * 8 - 8), std::invalid_argument);
+
+  /* the first next offset of the head, after the header, the head level and its key */
+  const size_t head_next = (40 + 8 + 8) / 8;
+  words[head_next] = 8;
+  FrozenSkiplist<int> backward(words.data(), words.size() * 8);
+  ASSERT_THROW(backward.Begin(), std::invalid_argument);
+  words[head_next] = words.size() * 8;
+  FrozenSkiplist<int> outside(words.data(), words.size() * 8);
+  ASSERT_THROW(outside.GetElementByRank(0), std::invalid_argument);
+}
+}  // namespace skiplist
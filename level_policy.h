@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace skiplist {
+
+/*
+ * Level policies.
+ *
+ * A level policy picks the level of every new node. It provides RandomLevel(), which returns a
+ * level within [1, MaxLevel], and two static constants: Branching, such that a node reaching
+ * level i reaches level i + 1 with a probability of 1 / Branching, and MaxLevel, which sizes the
+ * head node and every search path of the skiplist at compile time.
+ *
+ * A skiplist holds about Branching^MaxLevel keys before the top level stops thinning out, so
+ * MaxLevel should be raised with the expected size, and a larger Branching trades longer scans
+ * per level for fewer levels and less memory per node.
+ */
+
+/*
+ * RandomLevelPolicy draws levels from its own xorshift64* generator, so that there is no shared
+ * state between skiplists and no lock as with rand(). If Branching is a power of two, the level is
+ * derived from the number of trailing zero bits of a single random number instead of flipping a
+ * coin per level.
+ * A policy constructed with a seed always produces the same levels, which makes benchmarks
+ * reproducible. Otherwise every policy gets a different seed.
+ */
+template <size_t Branching_ = 2, size_t MaxLevel_ = 32>
+class RandomLevelPolicy {
+ public:
+  static_assert(Branching_ >= 2, "branching factor must be at least 2");
+  static_assert(MaxLevel_ >= 2 && MaxLevel_ <= 64, "max level must be within [2, 64]");
+  static constexpr const size_t Branching = Branching_;
+  static constexpr const size_t MaxLevel = MaxLevel_;
+  RandomLevelPolicy() : RandomLevelPolicy(NextSeed()) {}
+  explicit RandomLevelPolicy(uint64_t seed);
+  size_t RandomLevel();
+
+ private:
+  static constexpr size_t Log2(size_t n) { return n <= 1 ? 0 : 1 + Log2(n / 2); }
+  static constexpr const bool PowerOfTwo = (Branching & (Branching - 1)) == 0;
+  static constexpr const size_t BitsPerLevel = Log2(Branching);
+  static uint64_t NextSeed();
+  static size_t CountTrailingZeros(uint64_t x);
+  uint64_t Next();
+  uint64_t state_;
+};
+
+template <size_t Branching_, size_t MaxLevel_>
+constexpr const size_t RandomLevelPolicy<Branching_, MaxLevel_>::Branching;
+
+template <size_t Branching_, size_t MaxLevel_>
+constexpr const size_t RandomLevelPolicy<Branching_, MaxLevel_>::MaxLevel;
+
+template <size_t Branching_, size_t MaxLevel_>
+RandomLevelPolicy<Branching_, MaxLevel_>::RandomLevelPolicy(uint64_t seed) {
+  /* splitmix64, so that close seeds give unrelated sequences. the state must not be zero */
+  uint64_t z = seed + 0x9e3779b97f4a7c15;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  state_ = (z ^ (z >> 31)) | 1;
+}
+
+template <size_t Branching_, size_t MaxLevel_>
+size_t RandomLevelPolicy<Branching_, MaxLevel_>::RandomLevel() {
+  size_t level = 1;
+  if (PowerOfTwo) {
+    /* each level needs BitsPerLevel more zero bits */
+    level += CountTrailingZeros(Next()) / BitsPerLevel;
+  } else {
+    while (level < MaxLevel && Next() % Branching == 0) {
+      ++level;
+    }
+  }
+  return level < MaxLevel ? level : MaxLevel;
+}
+
+template <size_t Branching_, size_t MaxLevel_>
+uint64_t RandomLevelPolicy<Branching_, MaxLevel_>::Next() {
+  state_ ^= state_ >> 12;
+  state_ ^= state_ << 25;
+  state_ ^= state_ >> 27;
+  return state_ * 0x2545f4914f6cdd1d;
+}
+
+template <size_t Branching_, size_t MaxLevel_>
+uint64_t RandomLevelPolicy<Branching_, MaxLevel_>::NextSeed() {
+  static std::atomic<uint64_t> seed(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+  return seed.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <size_t Branching_, size_t MaxLevel_>
+size_t RandomLevelPolicy<Branching_, MaxLevel_>::CountTrailingZeros(uint64_t x) {
+  if (x == 0) return 64;
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(x);
+#else
+  size_t n = 0;
+  while ((x & 1) == 0) {
+    x >>= 1;
+    ++n;
+  }
+  return n;
+#endif
+}
+
+}  // namespace skiplist
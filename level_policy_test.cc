@@ -0,0 +1,109 @@
+#include "level_policy.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "skiplist.h"
+
+namespace skiplist {
+
+template <typename Policy>
+std::vector<size_t> CountLevels(Policy& policy, size_t n) {
+  std::vector<size_t> counts(Policy::MaxLevel + 1, 0);
+  for (size_t i = 0; i < n; ++i) {
+    size_t level = policy.RandomLevel();
+    EXPECT_GE(level, 1);
+    EXPECT_LE(level, Policy::MaxLevel);
+    ++counts[level];
+  }
+  return counts;
+}
+
+TEST(RandomLevelPolicyTest, Seed) {
+  RandomLevelPolicy<> p1(42), p2(42), p3(43);
+  std::vector<size_t> l1, l2, l3;
+  for (int i = 0; i < 1000; ++i) {
+    l1.push_back(p1.RandomLevel());
+    l2.push_back(p2.RandomLevel());
+    l3.push_back(p3.RandomLevel());
+  }
+  ASSERT_EQ(l1, l2);
+  ASSERT_NE(l1, l3);
+}
+
+TEST(RandomLevelPolicyTest, Distribution) {
+  const size_t n = 1 << 20;
+  RandomLevelPolicy<2> p2(1);
+  std::vector<size_t> c2 = CountLevels(p2, n);
+  /* about half of the nodes reach each next level */
+  ASSERT_NEAR(c2[1], n / 2, n / 100);
+  ASSERT_NEAR(c2[2], n / 4, n / 100);
+  ASSERT_NEAR(c2[3], n / 8, n / 100);
+
+  RandomLevelPolicy<4> p4(1);
+  std::vector<size_t> c4 = CountLevels(p4, n);
+  ASSERT_NEAR(c4[1], n * 3 / 4, n / 100);
+  ASSERT_NEAR(c4[2], n * 3 / 16, n / 100);
+
+  RandomLevelPolicy<3> p3(1);
+  std::vector<size_t> c3 = CountLevels(p3, n);
+  ASSERT_NEAR(c3[1], n * 2 / 3, n / 100);
+  ASSERT_NEAR(c3[2], n * 2 / 9, n / 100);
+
+  /* levels are capped */
+  RandomLevelPolicy<2, 2> p2_capped(1);
+  std::vector<size_t> capped = CountLevels(p2_capped, n);
+  ASSERT_NEAR(capped[2], n / 2, n / 100);
+  RandomLevelPolicy<5, 3> p5_capped(1);
+  capped = CountLevels(p5_capped, n);
+  ASSERT_NEAR(capped[3], n / 25, n / 100);
+}
+
+/* a policy building a plain linked list */
+struct FlatLevelPolicy {
+  static constexpr const size_t Branching = 2;
+  static constexpr const size_t MaxLevel = 2;
+  size_t RandomLevel() { return 1; }
+};
+
+TEST(RandomLevelPolicyTest, SkiplistPolicy) {
+  Skiplist<int, decltype(default_compare<int>), HeapAllocator, RandomLevelPolicy<4>> s1(
+      2, default_compare<int>, RandomLevelPolicy<4>(7));
+  Skiplist<int, decltype(default_compare<int>), HeapAllocator, FlatLevelPolicy> s2;
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(s1.Insert(i * 7 % 1000));
+    ASSERT_TRUE(s2.Insert(i * 7 % 1000));
+  }
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(s1.GetRankofElement(i), i);
+    ASSERT_EQ(s2.GetRankofElement(i), i);
+  }
+}
+
+TEST(RandomLevelPolicyTest, MaxLevel) {
+  /* a low max level keeps the skiplist correct, only slower once it outgrows it */
+  using Policy = RandomLevelPolicy<2, 3>;
+  Skiplist<int, decltype(default_compare<int>), HeapAllocator, Policy> s(
+      8, default_compare<int>, Policy(3));
+  std::vector<int> keys;
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(s.Insert(i * 7 % 1000));
+    keys.push_back(i);
+  }
+  ASSERT_EQ(s.GetElementsByRange(0, -1), keys);
+  for (int i = 0; i < 1000; i += 2) {
+    ASSERT_TRUE(s.Delete(i));
+  }
+  for (int i = 0; i < 500; ++i) {
+    ASSERT_EQ(s.GetElementByRank(i), i * 2 + 1);
+  }
+
+  keys.clear();
+  for (int i = 0; i < 1 << 12; ++i) keys.push_back(i);
+  s.BulkLoad(keys.begin(), keys.end(), true);
+  ASSERT_EQ(s.GetRankofElement(3000), 3000);
+  ASSERT_EQ(s.GetElementsByRange(0, -1), keys);
+}
+
+}  // namespace skiplist
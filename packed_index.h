@@ -0,0 +1,131 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+namespace skiplist {
+
+/*
+ * PackedIndex
+ *
+ * A static search tree over sorted 64-bit keys, in the style of cache-sensitive search trees.
+ * The keys are stored in blocks of 8, one cache line each, and every level above the keys holds
+ * the first key of each block of the level below, until a single block is left. A search reads
+ * one block per level, and finds its position within the block by comparing the key with all 8
+ * keys at once, with AVX2 or SSE4.2 when the compiler targets them and a scalar loop otherwise.
+ *
+ * Keys are stored with their sign bit flipped, so that unsigned keys can be compared with the
+ * signed comparisons of SSE and AVX2.
+ */
+class PackedIndex {
+ public:
+  PackedIndex() : base_(0), size_(0) {}
+  /* the keys must be sorted in ascending order */
+  explicit PackedIndex(const std::vector<uint64_t>& keys);
+  PackedIndex(const PackedIndex&) = delete;
+  PackedIndex& operator=(const PackedIndex&) = delete;
+  PackedIndex(PackedIndex&&) = default;
+  PackedIndex& operator=(PackedIndex&&) = default;
+  /* return the position of the last key less than `key`, or -1 if there is none */
+  ssize_t FindLastLess(uint64_t key) const;
+  /* return the key at the position */
+  uint64_t Get(size_t position) const { return Unflip(Level(0)[position]); }
+  size_t Size() const { return size_; }
+
+ private:
+  static constexpr const size_t BlockSize = 8;
+  static constexpr const size_t CacheLineSize = BlockSize * sizeof(int64_t);
+  static int64_t Flip(uint64_t key) { return static_cast<int64_t>(key ^ (1ULL << 63)); }
+  static uint64_t Unflip(int64_t key) { return static_cast<uint64_t>(key) ^ (1ULL << 63); }
+  static size_t CountLess(const int64_t* block, int64_t key);
+  const int64_t* Level(size_t level) const { return storage_.data() + base_ + levels_[level]; }
+  /* every level is padded to whole blocks, the first one starting on a cache line */
+  std::vector<int64_t> storage_;
+  size_t base_;
+  /* the offset of each level from base_, from the keys up to the root block */
+  std::vector<size_t> levels_;
+  size_t size_;
+};
+
+inline PackedIndex::PackedIndex(const std::vector<uint64_t>& keys) : base_(0), size_(keys.size()) {
+  if (keys.empty()) return;
+
+  std::vector<size_t> sizes;
+  size_t total = 0;
+  for (size_t n = keys.size();; n = (n + BlockSize - 1) / BlockSize) {
+    size_t padded = (n + BlockSize - 1) / BlockSize * BlockSize;
+    levels_.push_back(total);
+    sizes.push_back(n);
+    total += padded;
+    if (n <= BlockSize) break;
+  }
+
+  /* padding uses the largest key, which is never less than any key */
+  storage_.assign(total + BlockSize - 1, INT64_MAX);
+  uintptr_t address = reinterpret_cast<uintptr_t>(storage_.data());
+  base_ = (CacheLineSize - address % CacheLineSize) % CacheLineSize / sizeof(int64_t);
+
+  int64_t* level = storage_.data() + base_;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    level[i] = Flip(keys[i]);
+  }
+  for (size_t l = 1; l < levels_.size(); ++l) {
+    const int64_t* below = storage_.data() + base_ + levels_[l - 1];
+    int64_t* current = storage_.data() + base_ + levels_[l];
+    for (size_t i = 0; i < sizes[l]; ++i) {
+      current[i] = below[i * BlockSize];
+    }
+  }
+}
+
+inline ssize_t PackedIndex::FindLastLess(uint64_t key) const {
+  if (size_ == 0) return -1;
+
+  const int64_t flipped = Flip(key);
+  size_t block = 0;
+  for (size_t l = levels_.size(); l-- > 0;) {
+    size_t count = CountLess(Level(l) + block * BlockSize, flipped);
+    /* below the root, the first key of the block is less than the key by construction */
+    if (count == 0) return -1;
+    block = block * BlockSize + count - 1;
+  }
+  return block;
+}
+
+inline size_t PackedIndex::CountLess(const int64_t* block, int64_t key) {
+#if defined(__AVX2__)
+  const __m256i k = _mm256_set1_epi64x(key);
+  __m256i lo = _mm256_cmpgt_epi64(k, _mm256_load_si256(reinterpret_cast<const __m256i*>(block)));
+  __m256i hi =
+      _mm256_cmpgt_epi64(k, _mm256_load_si256(reinterpret_cast<const __m256i*>(block + 4)));
+  int mask = _mm256_movemask_pd(_mm256_castsi256_pd(lo)) |
+             (_mm256_movemask_pd(_mm256_castsi256_pd(hi)) << 4);
+  return __builtin_popcount(mask);
+#elif defined(__SSE4_2__)
+  const __m128i k = _mm_set1_epi64x(key);
+  int mask = 0;
+  for (size_t i = 0; i < BlockSize; i += 2) {
+    __m128i lt = _mm_cmpgt_epi64(k, _mm_load_si128(reinterpret_cast<const __m128i*>(block + i)));
+    mask |= _mm_movemask_pd(_mm_castsi128_pd(lt)) << i;
+  }
+  return __builtin_popcount(mask);
+#else
+  /* the keys are sorted, and branch-free counting lets the compiler vectorize the loop */
+  size_t count = 0;
+  for (size_t i = 0; i < BlockSize; ++i) {
+    count += block[i] < key;
+  }
+  return count;
+#endif
+}
+
+}  // namespace skiplist
@@ -0,0 +1,62 @@
+#include "packed_index.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+namespace skiplist {
+TEST(PackedIndexTest, Empty) {
+  PackedIndex index;
+  ASSERT_EQ(index.FindLastLess(0), -1);
+  ASSERT_EQ(index.FindLastLess(UINT64_MAX), -1);
+
+  PackedIndex built(std::vector<uint64_t>{});
+  ASSERT_EQ(built.Size(), 0);
+  ASSERT_EQ(built.FindLastLess(42), -1);
+}
+
+TEST(PackedIndexTest, FindLastLess) {
+  /* sizes around the block size and the number of levels */
+  for (size_t n : {1, 7, 8, 9, 63, 64, 65, 512, 513, 5000}) {
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < n; ++i) {
+      keys.push_back(i * 2 + 1);
+    }
+    PackedIndex index(keys);
+    ASSERT_EQ(index.Size(), n);
+    ASSERT_EQ(index.FindLastLess(0), -1);
+    ASSERT_EQ(index.FindLastLess(1), -1);
+    for (size_t i = 0; i < n; ++i) {
+      ASSERT_EQ(index.FindLastLess(i * 2 + 1), static_cast<ssize_t>(i) - 1);
+      ASSERT_EQ(index.FindLastLess(i * 2 + 2), i);
+      ASSERT_EQ(index.Get(i), i * 2 + 1);
+    }
+    ASSERT_EQ(index.FindLastLess(UINT64_MAX), n - 1);
+  }
+}
+
+TEST(PackedIndexTest, UnsignedOrder) {
+  /* keys above INT64_MAX are ordered as unsigned integers */
+  std::mt19937_64 rng(3);
+  std::vector<uint64_t> keys = {0, 1, INT64_MAX, uint64_t(INT64_MAX) + 1, UINT64_MAX};
+  for (int i = 0; i < 1000; ++i) {
+    keys.push_back(rng());
+  }
+  std::sort(keys.begin(), keys.end());
+  PackedIndex index(keys);
+
+  for (int i = 0; i < 1000; ++i) {
+    uint64_t key = i < 5 ? keys[i] : rng();
+    ssize_t expected = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin() - 1;
+    ASSERT_EQ(index.FindLastLess(key), expected);
+  }
+
+  /* moving keeps the blocks aligned */
+  PackedIndex moved(std::move(index));
+  ASSERT_EQ(moved.FindLastLess(UINT64_MAX), keys.size() - 2);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_EQ(moved.Get(i), keys[i]);
+  }
+}
+}  // namespace skiplist
@@ -1,6 +1,26 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "arena.h"
+#include "epoch.h"
+#include "level_policy.h"
+#include "packed_index.h"
+#include "snapshot.h"
 
 namespace skiplist {
 
@@ -8,423 +28,2202 @@ template <typename Key>
 const auto default_compare =
     [](const Key& k1, const Key& k2) { return k1 < k2 ? -1 : (k1 == k2 ? 0 : 1); };
 
-template <typename Key, typename Comparator = decltype(default_compare<Key>)>
+/*
+ * three-way comparator for any two types comparable with operators `<` and `==`.
+ * it declares is_transparent, so a skiplist using it can be searched with any type comparable to
+ * its keys, e.g. a std::string_view or a const char* for std::string keys, without constructing a
+ * temporary key.
+ */
+struct TransparentCompare {
+  using is_transparent = void;
+  template <typename K1, typename K2>
+  int operator()(const K1& k1, const K2& k2) const {
+    return k1 < k2 ? -1 : (k1 == k2 ? 0 : 1);
+  }
+};
+
+/* whether the comparator declares is_transparent */
+template <typename Comparator, typename = void>
+struct IsTransparent : std::false_type {};
+
+template <typename Comparator>
+struct IsTransparent<Comparator, decltype(std::declval<typename Comparator::is_transparent*>(),
+                                          void())> : std::true_type {};
+
+/*
+ * Key prefixes.
+ *
+ * A comparator may map keys to 64-bit prefixes through a Prefix(key) member, such that a key with
+ * a smaller prefix is always smaller. The skiplist then caches the prefix of each key in its node
+ * and compares the keys themselves only when the prefixes are equal, so most steps of a search
+ * are a single integer comparison that does not touch the key. Lookup types used with a
+ * transparent comparator need a Prefix overload as well.
+ */
+template <typename Comparator, typename Key, typename = void>
+struct HasKeyPrefix : std::false_type {};
+
+template <typename Comparator, typename Key>
+struct HasKeyPrefix<
+    Comparator, Key,
+    typename std::enable_if<std::is_same<decltype(std::declval<const Comparator&>().Prefix(
+                                             std::declval<const Key&>())),
+                                         uint64_t>::value>::type> : std::true_type {};
+
+/*
+ * transparent comparator for std::string keys, whose prefix is their first 8 bytes read as a
+ * big-endian integer and padded with zeros. it accepts any lookup type with data() and size()
+ * such as std::string_view, and null-terminated strings.
+ */
+struct StringPrefixCompare : TransparentCompare {
+  template <typename S>
+  auto Prefix(const S& key) const -> decltype(key.data(), key.size(), uint64_t()) {
+    return LoadPrefix(key.data(), key.size());
+  }
+  uint64_t Prefix(const char* key) const {
+    size_t size = 0;
+    while (size < sizeof(uint64_t) && key[size]) ++size;
+    return LoadPrefix(key, size);
+  }
+
+ private:
+  static uint64_t LoadPrefix(const char* data, size_t size) {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+      prefix = (prefix << 8) | (i < size ? static_cast<unsigned char>(data[i]) : 0);
+    }
+    return prefix;
+  }
+};
+
+/* three-way comparator for integer keys, whose prefix is the key itself in unsigned order */
+template <typename Int>
+struct IntegerCompare {
+  static_assert(std::is_integral<Int>::value && sizeof(Int) <= sizeof(uint64_t),
+                "keys must be integers of at most 64 bits");
+  int operator()(Int k1, Int k2) const { return k1 < k2 ? -1 : (k1 == k2 ? 0 : 1); }
+  uint64_t Prefix(Int key) const {
+    /* flipping the sign bit orders negative integers before positive ones */
+    uint64_t prefix = static_cast<uint64_t>(static_cast<int64_t>(key));
+    return std::is_signed<Int>::value ? prefix ^ (1ULL << 63) : static_cast<uint64_t>(key);
+  }
+};
+
+/* the cached key prefix of a node, empty if the comparator provides no prefixes */
+template <bool Enabled>
+struct NodePrefix {
+  uint64_t GetPrefix() const { return prefix_; }
+  void SetPrefix(uint64_t prefix) { prefix_ = prefix; }
+  uint64_t prefix_ = 0;
+};
+
+template <>
+struct NodePrefix<false> {
+  uint64_t GetPrefix() const { return 0; }
+  void SetPrefix(uint64_t) {}
+};
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+class SortedMap;
+
+template <typename Key, typename Comparator = decltype(default_compare<Key>),
+          typename Allocator = HeapAllocator, typename LevelPolicy = RandomLevelPolicy<>>
 class Skiplist {
  private:
   struct SkiplistLevel;
   struct SkiplistNode;
+  struct SearchIndex;
+  class Builder;
+  template <typename Member, typename Score, typename Hash, typename Alloc>
+  friend class SortedMap;
 
  public:
   class Iterator;
+  using ReverseIterator = std::reverse_iterator<Iterator>;
+  template <bool Reverse>
+  class View;
+  /*
+   * lookups accept any type K if the comparator is transparent, in which case compare_(key, k)
+   * must order a key and a K consistently with the order of the keys.
+   */
+  template <typename K>
+  using LookupKey = typename std::enable_if<std::is_same<K, Key>::value ||
+                                            IsTransparent<Comparator>::value>::type;
   Skiplist();
   explicit Skiplist(const size_t level);
   explicit Skiplist(const size_t level, const Comparator& compare_);
+  explicit Skiplist(const size_t level, const Comparator& compare_,
+                    const LevelPolicy& level_policy);
+  Skiplist(const Skiplist&) = delete;
+  Skiplist& operator=(const Skiplist&) = delete;
+  Skiplist(Skiplist&& skiplist);
+  Skiplist& operator=(Skiplist&& skiplist);
   Iterator Begin() const;
   Iterator End() const;
+  ReverseIterator RBegin() const { return ReverseIterator(End()); }
+  ReverseIterator REnd() const { return ReverseIterator(Begin()); }
+  /* standard names, for range-based for loops and STL algorithms */
+  Iterator begin() const { return Begin(); }
+  Iterator end() const { return End(); }
+  ReverseIterator rbegin() const { return RBegin(); }
+  ReverseIterator rend() const { return REnd(); }
+  Iterator LowerBound(const Key& key) const { return LowerBound<Key>(key); }
+  template <typename K, typename = LookupKey<K>>
+  Iterator LowerBound(const K& key) const;
+  Iterator UpperBound(const Key& key) const { return UpperBound<Key>(key); }
+  template <typename K, typename = LookupKey<K>>
+  Iterator UpperBound(const K& key) const;
   bool Insert(const Key& key);
-  bool Contains(const Key& key);
-  bool Delete(const Key& key);
+  bool Insert(Key&& key);
+  template <typename... Args>
+  bool Emplace(Args&&... args);
+  template <typename InputIt>
+  void BulkLoad(InputIt first, InputIt last, bool balanced = false);
+  template <typename InputIt>
+  size_t InsertBatch(InputIt first, InputIt last);
+  bool Contains(const Key& key) { return Contains<Key>(key); }
+  template <typename K, typename = LookupKey<K>>
+  bool Contains(const K& key);
+  template <typename InputIt>
+  std::vector<bool> ContainsBatch(InputIt first, InputIt last);
+  template <typename ForwardIt>
+  std::vector<bool> ContainsMany(ForwardIt first, ForwardIt last);
+  bool Delete(const Key& key) { return Delete<Key>(key); }
+  template <typename K, typename = LookupKey<K>>
+  bool Delete(const K& key);
+  template <typename InputIt>
+  size_t DeleteBatch(InputIt first, InputIt last);
+  bool DeleteByRank(int rank);
+  size_t DeleteRankRange(int start, int end);
+  size_t DeleteRange(const Key& start, const Key& end) { return DeleteRange<Key, Key>(start, end); }
+  template <typename K1, typename K2, typename = LookupKey<K1>, typename = LookupKey<K2>>
+  size_t DeleteRange(const K1& start, const K2& end);
   bool Update(const Key& key, const Key& new_key);
+  bool Update(const Key& key, Key&& new_key);
+  const Key& Front();
+  const Key& Back();
+  bool PopFront(Key* key = nullptr);
+  bool PopBack(Key* key = nullptr);
   const Key& GetElementByRank(int rank);
-  ssize_t GetRankofElement(const Key& key);
+  ssize_t GetRankofElement(const Key& key) { return GetRankofElement<Key>(key); }
+  template <typename K, typename = LookupKey<K>>
+  ssize_t GetRankofElement(const K& key);
+  template <typename ForwardIt>
+  std::vector<ssize_t> RankMany(ForwardIt first, ForwardIt last);
+  size_t Count(const Key& key) { return Count<Key>(key); }
+  template <typename K, typename = LookupKey<K>>
+  size_t Count(const K& key);
+  View<false> EqualRange(const Key& key) { return EqualRange<Key>(key); }
+  template <typename K, typename = LookupKey<K>>
+  View<false> EqualRange(const K& key);
   std::vector<Key> GetElementsByRange(int start, int end);
+  std::vector<Key> GetElementsByRange(int start, int end, size_t threads);
   std::vector<Key> GetElementsByRevRange(int start, int end);
-  std::vector<Key> GetElementsGt(const Key& start);
-  std::vector<Key> GetElementsGte(const Key& start);
-  std::vector<Key> GetElementsLt(const Key& end);
-  std::vector<Key> GetElementsLte(const Key& end);
-  std::vector<Key> GetElementsInRange(const Key& start, const Key& end);
+  std::vector<Key> GetElementsGt(const Key& start) { return GetElementsGt<Key>(start); }
+  template <typename K, typename = LookupKey<K>>
+  std::vector<Key> GetElementsGt(const K& start);
+  std::vector<Key> GetElementsGte(const Key& start) { return GetElementsGte<Key>(start); }
+  template <typename K, typename = LookupKey<K>>
+  std::vector<Key> GetElementsGte(const K& start);
+  std::vector<Key> GetElementsLt(const Key& end) { return GetElementsLt<Key>(end); }
+  template <typename K, typename = LookupKey<K>>
+  std::vector<Key> GetElementsLt(const K& end);
+  std::vector<Key> GetElementsLte(const Key& end) { return GetElementsLte<Key>(end); }
+  template <typename K, typename = LookupKey<K>>
+  std::vector<Key> GetElementsLte(const K& end);
+  std::vector<Key> GetElementsInRange(const Key& start, const Key& end) {
+    return GetElementsInRange<Key, Key>(start, end);
+  }
+  template <typename K1, typename K2, typename = LookupKey<K1>, typename = LookupKey<K2>>
+  std::vector<Key> GetElementsInRange(const K1& start, const K2& end);
+  std::vector<Key> GetElementsInRange(const Key& start, const Key& end, size_t threads) {
+    return GetElementsInRange<Key, Key>(start, end, threads);
+  }
+  template <typename K1, typename K2, typename = LookupKey<K1>, typename = LookupKey<K2>>
+  std::vector<Key> GetElementsInRange(const K1& start, const K2& end, size_t threads);
+  View<false> Range(const Key& start, const Key& end) { return Range<Key, Key>(start, end); }
+  template <typename K1, typename K2, typename = LookupKey<K1>, typename = LookupKey<K2>>
+  View<false> Range(const K1& start, const K2& end);
+  View<false> RankRange(int start, int end);
+  View<true> RevRange(int start, int end);
+  template <typename Visitor>
+  void ForEachInRange(const Key& start, const Key& end, Visitor visit) {
+    ForEachInRange<Key, Key, Visitor>(start, end, visit);
+  }
+  template <typename K1, typename K2, typename Visitor, typename = LookupKey<K1>,
+            typename = LookupKey<K2>>
+  void ForEachInRange(const K1& start, const K2& end, Visitor visit);
+  template <typename Visitor>
+  void ForEachParallel(Visitor visit, size_t threads = 0);
   const Key& operator[](size_t i);
-  size_t Size() { return size_; }
+  size_t Size() const { return size_; }
+  Skiplist SplitAt(const Key& key) { return SplitAt<Key>(key); }
+  template <typename K, typename = LookupKey<K>>
+  Skiplist SplitAt(const K& key);
+  Skiplist SplitAtRank(size_t rank);
+  void Concat(Skiplist& skiplist);
+  Skiplist Union(const Skiplist& skiplist) const { return Merge<true, true, true>(skiplist); }
+  Skiplist Intersect(const Skiplist& skiplist) const { return Merge<false, true, false>(skiplist); }
+  Skiplist Difference(const Skiplist& skiplist) const {
+    return Merge<true, false, false>(skiplist);
+  }
+  Skiplist MergeMany(const std::vector<const Skiplist*>& skiplists, size_t threads = 0) const {
+    return CombineMany<false>(skiplists, threads);
+  }
+  Skiplist IntersectMany(const std::vector<const Skiplist*>& skiplists, size_t threads = 0) const {
+    return CombineMany<true>(skiplists, threads);
+  }
+  template <typename Codec = KeyCodec<Key>>
+  void SaveSnapshot(std::ostream& out, bool checksum = true, const Codec& codec = Codec()) const;
+  template <typename Codec = KeyCodec<Key>>
+  void LoadSnapshot(std::istream& in, const Codec& codec = Codec());
+  void EnableConcurrentReads();
+  void EnableDuplicates();
+  void BuildSearchIndex();
   void Clear();
   void Print() const;
   ~Skiplist();
 
  private:
   static constexpr const int InitSkiplistLevel = 2;
-  static constexpr const int MaxSkiplistLevel = 16;
-  static constexpr const double SkiplistP = 0.5;
+  static constexpr const int MaxSkiplistLevel = LevelPolicy::MaxLevel;
+  static constexpr const bool CachePrefix = HasKeyPrefix<Comparator, Key>::value;
+  /* the search index holds the nodes reaching this level */
+  static constexpr const int IndexedLevel = 2;
+  /* the number of searches interleaved by SearchMany */
+  static constexpr const size_t SearchGroupSize = 16;
+  /* Merge skips over a skiplist this many times larger than the other one instead of stepping */
+  static constexpr const size_t GallopRatio = 8;
+  /* parallel operations give each partition at least this many keys */
+  static constexpr const size_t MinPartitionSize = 1 << 12;
+  /* CombineMany samples this many splitters per partition */
+  static constexpr const size_t SamplesPerPartition = 8;
+  static_assert(MaxSkiplistLevel >= InitSkiplistLevel && MaxSkiplistLevel <= UINT8_MAX,
+                "unsupported max level");
   size_t RandomLevel();
-  bool Lt(const Key& k1, const Key& k2);
-  bool Lte(const Key& k1, const Key& k2);
-  bool Gt(const Key& k1, const Key& k2);
-  bool Gte(const Key& k1, const Key& k2);
-  bool Eq(const Key& k1, const Key& k2);
-  void DeleteNode(const Key& key, SkiplistNode* prev[MaxSkiplistLevel]);
+  static size_t BalancedLevel(size_t rank);
+  template <typename K>
+  bool Lt(const Key& k1, const K& k2) const;
+  template <typename K>
+  bool Lte(const Key& k1, const K& k2) const;
+  template <typename K>
+  bool Gt(const Key& k1, const K& k2) const;
+  template <typename K>
+  bool Gte(const Key& k1, const K& k2) const;
+  template <typename K>
+  bool Eq(const Key& k1, const K& k2) const;
+  template <typename K>
+  uint64_t KeyPrefix(const K& key) const;
+  template <typename K>
+  uint64_t KeyPrefix(const K& key, std::true_type) const;
+  template <typename K>
+  uint64_t KeyPrefix(const K&, std::false_type) const;
+  template <typename K>
+  int Compare(const SkiplistNode* node, const K& key, uint64_t prefix) const;
+  template <typename... Args>
+  SkiplistNode* CreateNode(size_t level, Args&&... args);
+  void ExpandLevel(size_t level);
+  template <typename K>
+  SkiplistNode* InsertNode(K&& key);
+  bool FindInsertPosition(const Key& key, SkiplistNode* update[MaxSkiplistLevel],
+                          size_t rank[MaxSkiplistLevel]);
+  void LinkNode(SkiplistNode* node, SkiplistNode* update[MaxSkiplistLevel],
+                size_t rank[MaxSkiplistLevel]);
+  void InitFinger(SkiplistNode* update[MaxSkiplistLevel], size_t rank[MaxSkiplistLevel]);
+  void MoveFinger(const Key& key, bool inclusive, SkiplistNode* update[MaxSkiplistLevel],
+                  size_t rank[MaxSkiplistLevel]);
+  template <typename Modifier>
+  SkiplistNode* UpdateNode(const Key& key, Modifier modify);
+  void DeleteNode(SkiplistNode* node, SkiplistNode* update[MaxSkiplistLevel]);
+  void UnlinkNode(SkiplistNode* node, SkiplistNode* update[MaxSkiplistLevel]);
+  size_t DeleteRun(size_t start, size_t count);
+  template <bool Left, bool Both, bool Right>
+  Skiplist Merge(const Skiplist& skiplist) const;
+  const SkiplistNode* SkipTo(const SkiplistNode* node, const Key& key) const;
+  template <bool Intersect>
+  Skiplist CombineMany(const std::vector<const Skiplist*>& skiplists, size_t threads) const;
+  static LevelPolicy PartitionPolicy(const LevelPolicy& level_policy, size_t partition,
+                                     std::true_type);
+  static LevelPolicy PartitionPolicy(const LevelPolicy& level_policy, size_t partition,
+                                     std::false_type);
+  template <typename Codec>
+  bool ReadSnapshot(std::istream& in, const Codec& codec, Builder* builder) const;
+  void PublishNodes(SkiplistNode* head, const Builder& builder);
+  void ConcatPartitions(std::vector<Skiplist>& partitions, std::true_type);
+  void ConcatPartitions(std::vector<Skiplist>& partitions, std::false_type);
+  template <bool Intersect>
+  void CombineRange(const std::vector<const Skiplist*>& skiplists, const Key* lower,
+                    const Key* upper, Skiplist* result) const;
+  std::vector<const Key*> Splitters(const std::vector<const Skiplist*>& skiplists,
+                                    size_t partitions) const;
+  std::vector<Key> GetElementsParallel(size_t start, size_t count, size_t threads);
+  template <typename Visit>
+  void VisitRanksParallel(size_t start, size_t count, size_t threads, Visit visit);
+  static size_t Partitions(size_t count, size_t threads);
+  template <typename Task>
+  static void RunParallel(size_t tasks, Task task);
   const SkiplistNode* GetElement(size_t rank);
   std::vector<Key> GetElements(size_t start, size_t end);
   std::vector<Key> GetElementsRev(size_t start, size_t end);
-  std::vector<Key> GetElementsGt(const Key& start, bool Eq);
-  std::vector<Key> GetElementsLt(const Key& end, bool Eq);
-  const SkiplistNode* GetFirstElementGt(const Key& key, bool Eq);
-  const SkiplistNode* GetLastElementLt(const Key& key, bool Eq);
+  template <typename K>
+  std::vector<Key> GetElementsGt(const K& start, bool Eq);
+  template <typename K>
+  std::vector<Key> GetElementsLt(const K& end, bool Eq);
+  template <typename K>
+  const SkiplistNode* GetFirstElementGt(const K& key, bool Eq, size_t* rank = nullptr) const;
+  template <typename K>
+  const SkiplistNode* GetLastElementLt(const K& key, bool Eq) const;
   void Reset();
+  void FreeNodes();
+  void DropNode(SkiplistNode* node);
+  void RetireNode(SkiplistNode* node, size_t count);
+  void ReclaimNodes(bool all);
   const SkiplistNode* FindLast() const;
+  const SkiplistNode* SearchStart(uint64_t prefix, int* level, size_t* rank) const;
+  const SkiplistNode* RankSearchStart(size_t position, int* level, size_t* rank) const;
+  template <typename ForwardIt, typename Visit>
+  void SearchMany(ForwardIt first, ForwardIt last, Visit visit) const;
+  static void Prefetch(const void* p);
+  void DropSearchIndex();
+  void MoveFrom(Skiplist& skiplist);
+  void AssignComparator(const Comparator& compare, std::true_type);
+  void AssignComparator(const Comparator& compare, std::false_type);
+  static constexpr const size_t ReclaimThreshold = 64;
+  struct RetiredNode {
+    SkiplistNode* node_;
+    uint64_t epoch_;
+    /* the number of nodes retired in level 0, starting at node_ */
+    size_t count_;
+  };
+  Allocator allocator_;
+  LevelPolicy level_policy_;
   SkiplistNode* head_;
-  const Comparator compare_;
-  size_t level_;
-  size_t size_;
+  /* the last node, or the head if the skiplist is empty */
+  std::atomic<SkiplistNode*> tail_;
+  /* default_compare is a const variable, so its type is const-qualified */
+  typename std::remove_const<Comparator>::type compare_;
+  /* level_ and size_ are read by concurrent readers, but only ever written by the writer */
+  std::atomic<size_t> level_;
+  std::atomic<size_t> size_;
+  bool concurrent_reads_;
+  /*
+   * whether equal keys may be inserted, in which case they are kept in insertion order. atomic
+   * like level_, since LoadSnapshot may enable duplicates while concurrent readers are running.
+   */
+  std::atomic<bool> duplicates_;
+  /* deleted nodes that concurrent readers may still be reading */
+  std::vector<RetiredNode> retired_;
+  /* packed upper levels, dropped by every write */
+  std::atomic<SearchIndex*> index_;
 };
 
+/* Skiplist allocating its nodes from a slab arena */
+template <typename Key, typename Comparator = decltype(default_compare<Key>),
+          typename LevelPolicy = RandomLevelPolicy<>>
+using ArenaSkiplist = Skiplist<Key, Comparator, Arena, LevelPolicy>;
+
 /* SkiplistLevel */
-template <typename Key, typename Comparator>
-struct Skiplist<Key, Comparator>::SkiplistLevel {
-  explicit SkiplistLevel(SkiplistNode* next, size_t span) : next_(next), span_(span){};
-  void Reset();
-  ~SkiplistLevel() { Reset(); }
-  SkiplistNode* next_;
-  size_t span_;
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+struct Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistLevel {
+  std::atomic<SkiplistNode*> next_;
+  std::atomic<size_t> span_;
 };
 
-template <typename Key, typename Comparator>
-void Skiplist<Key, Comparator>::SkiplistLevel::Reset() {
-  next_ = nullptr;
-  span_ = 0;
-}
-
-/* SkiplistNode */
-template <typename Key, typename Comparator>
-struct Skiplist<Key, Comparator>::SkiplistNode {
+/*
+ * SkiplistNode
+ *
+ * The key, the backward pointer and exactly `level` next/span pairs are laid out in one
+ * contiguous allocation. levels_ is declared with a single element but the node is allocated
+ * with room for `level` of them, like leveldb's Node.
+ *
+ * Like leveldb's Node, next pointers are published with release stores and read with acquire
+ * loads, so that a reader following a pointer always sees a fully initialized node even while
+ * the writer is inserting.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+struct Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode : NodePrefix<CachePrefix> {
  public:
-  static SkiplistNode* CreateSkiplistNode(const Key& key, size_t level);
-  static SkiplistNode* CreateSkiplistNode(size_t level);
-  const SkiplistNode* GetNext(size_t level) const { return levels_[level]->next_; };
-  SkiplistNode* GetNext(size_t level) { return levels_[level]->next_; };
+  template <typename... Args>
+  static SkiplistNode* CreateSkiplistNode(Allocator& allocator, size_t level, Args&&... args);
+  static void DestroySkiplistNode(Allocator& allocator, SkiplistNode* node);
+  const SkiplistNode* GetNext(size_t level) const {
+    return levels_[level].next_.load(std::memory_order_acquire);
+  };
+  SkiplistNode* GetNext(size_t level) {
+    return levels_[level].next_.load(std::memory_order_acquire);
+  };
   void SetNext(size_t level, const SkiplistNode* next) {
-    levels_[level]->next_ = const_cast<SkiplistNode*>(next);
+    levels_[level].next_.store(const_cast<SkiplistNode*>(next), std::memory_order_release);
   };
-  size_t GetSpan(size_t level) const { return levels_[level]->span_; };
-  size_t GetSpan(size_t level) { return levels_[level]->span_; };
-  void SetSpan(size_t level, size_t span_) { levels_[level]->span_ = span_; };
-  const SkiplistNode* GetPrev() const { return prev_; };
-  SkiplistNode* GetPrev() { return prev_; };
-  void SetPrev(const SkiplistNode* prev_node) { prev_ = const_cast<SkiplistNode*>(prev_node); };
-  void InitLevel(size_t level) { levels_[level] = new SkiplistLevel(nullptr, 0); };
-  void Reset();
-  ~SkiplistNode();
+  size_t GetSpan(size_t level) const {
+    return levels_[level].span_.load(std::memory_order_relaxed);
+  };
+  void SetSpan(size_t level, size_t span_) {
+    levels_[level].span_.store(span_, std::memory_order_relaxed);
+  };
+  const SkiplistNode* GetPrev() const { return prev_.load(std::memory_order_acquire); };
+  SkiplistNode* GetPrev() { return prev_.load(std::memory_order_acquire); };
+  void SetPrev(const SkiplistNode* prev_node) {
+    prev_.store(const_cast<SkiplistNode*>(prev_node), std::memory_order_release);
+  };
+  size_t GetLevel() const { return level_; };
+  void InitLevel(size_t level) {
+    levels_[level].next_.store(nullptr, std::memory_order_relaxed);
+    levels_[level].span_.store(0, std::memory_order_relaxed);
+  };
+  void Reset(size_t level);
   Key key_;
 
  private:
-  SkiplistNode() : prev_(nullptr) { memset(levels_, 0, sizeof levels_); };
-  explicit SkiplistNode(const Key& key) : key_(key), prev_(nullptr) {
-    memset(levels_, 0, sizeof levels_);
-  };
-  SkiplistLevel* levels_[MaxSkiplistLevel];
-  SkiplistNode* prev_;
+  /* the key is constructed in place from args, or value-initialized for the head */
+  template <typename... Args>
+  explicit SkiplistNode(size_t level, Args&&... args)
+      : key_(std::forward<Args>(args)...), level_(level), prev_(nullptr){};
+  static size_t AllocationSize(size_t level);
+  uint8_t level_;
+  std::atomic<SkiplistNode*> prev_;
+  SkiplistLevel levels_[1];
 };
 
-template <typename Key, typename Comparator>
-typename Skiplist<Key, Comparator>::SkiplistNode*
-Skiplist<Key, Comparator>::SkiplistNode::CreateSkiplistNode(const Key& key, size_t level) {
-  SkiplistNode* n = new SkiplistNode(key);
-  for (int i = 0; i < level; ++i) {
-    n->InitLevel(i);
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+size_t
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode::AllocationSize(size_t level) {
+  return sizeof(SkiplistNode) + sizeof(SkiplistLevel) * (level - 1);
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename... Args>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode*
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode::CreateSkiplistNode(
+    Allocator& allocator, size_t level, Args&&... args) {
+  void* mem = allocator.Allocate(AllocationSize(level), level);
+  SkiplistNode* n;
+  try {
+    n = new (mem) SkiplistNode(level, std::forward<Args>(args)...);
+  } catch (...) {
+    allocator.Deallocate(mem, AllocationSize(level), level);
+    throw;
   }
+  n->Reset(level);
   return n;
 }
 
-template <typename Key, typename Comparator>
-typename Skiplist<Key, Comparator>::SkiplistNode*
-Skiplist<Key, Comparator>::SkiplistNode::CreateSkiplistNode(size_t level) {
-  SkiplistNode* n = new SkiplistNode();
-  for (int i = 0; i < level; ++i) {
-    n->InitLevel(i);
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode::DestroySkiplistNode(
+    Allocator& allocator, SkiplistNode* node) {
+  size_t level = node->level_;
+  node->~SkiplistNode();
+  allocator.Deallocate(node, AllocationSize(level), level);
+}
+
+/*
+ * SearchIndex
+ *
+ * The prefixes and the 1-based ranks of the nodes reaching IndexedLevel, packed into static search
+ * trees of cache line sized blocks. Finding the node to start from costs one cache line per tree
+ * level, instead of one dependent pointer load per node in the upper levels of the skiplist.
+ * The rank of the node found is read back from the keys of ranks_ at the same position.
+ * Every indexed node costs a prefix and a rank of 8 bytes each, both about 1/7 larger with the
+ * upper levels of their trees, and a node pointer of 8 bytes: about 26 bytes, so about
+ * 26 / Branching bytes per key of the skiplist.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+struct Skiplist<Key, Comparator, Allocator, LevelPolicy>::SearchIndex {
+  PackedIndex prefixes_;
+  PackedIndex ranks_;
+  std::vector<const SkiplistNode*> nodes_;
+};
+
+/*
+ * Builder
+ *
+ * Appends keys in ascending order to an empty skiplist in O(1) each, keeping the last node of each
+ * level and its rank. The spans of the last nodes, the tail and the size are only set by Finish(),
+ * which must be called before the skiplist is used again.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+class Skiplist<Key, Comparator, Allocator, LevelPolicy>::Builder {
+ public:
+  /* if `balanced` is set, the level of each node is derived from its rank */
+  Builder(Skiplist* skiplist, bool balanced);
+  /* append nodes of the skiplist under a head of their own, leaving the skiplist unchanged */
+  Builder(Skiplist* skiplist, SkiplistNode* head);
+  template <typename... Args>
+  void Append(Args&&... args);
+  void Finish();
+  const SkiplistNode* Last() const { return tail_[0]; }
+  size_t Size() const { return size_; }
+  size_t Level() const { return level_; }
+
+ private:
+  Skiplist* skiplist_;
+  SkiplistNode* head_;
+  bool balanced_;
+  SkiplistNode* tail_[MaxSkiplistLevel];
+  size_t tail_rank_[MaxSkiplistLevel];
+  size_t size_;
+  size_t level_;
+};
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Builder::Builder(Skiplist* skiplist,
+                                                                    bool balanced)
+    : skiplist_(skiplist),
+      head_(skiplist->head_),
+      balanced_(balanced),
+      size_(0),
+      level_(skiplist->level_) {
+  std::fill(tail_, tail_ + MaxSkiplistLevel, head_);
+  std::fill(tail_rank_, tail_rank_ + MaxSkiplistLevel, 0);
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Builder::Builder(Skiplist* skiplist,
+                                                                    SkiplistNode* head)
+    : skiplist_(skiplist), head_(head), balanced_(false), size_(0), level_(InitSkiplistLevel) {
+  std::fill(tail_, tail_ + MaxSkiplistLevel, head_);
+  std::fill(tail_rank_, tail_rank_ + MaxSkiplistLevel, 0);
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename... Args>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::Builder::Append(Args&&... args) {
+  size_t node_level = balanced_ ? BalancedLevel(size_ + 1) : skiplist_->RandomLevel();
+  SkiplistNode* node = skiplist_->CreateNode(node_level, std::forward<Args>(args)...);
+  ++size_;
+  node->SetPrev(tail_[0]);
+  for (size_t i = 0; i < node_level; ++i) {
+    tail_[i]->SetSpan(i, size_ - tail_rank_[i]);
+    tail_[i]->SetNext(i, node);
+    tail_[i] = node;
+    tail_rank_[i] = size_;
   }
-  return n;
+  level_ = std::max(level_, node_level);
 }
 
-template <typename Key, typename Comparator>
-void Skiplist<Key, Comparator>::SkiplistNode::Reset() {
-  for (int i = 0; i < MaxSkiplistLevel; ++i) {
-    delete levels_[i];
-    levels_[i] = nullptr;
+/* the last node of each level spans the nodes after it, like in LinkNode */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::Builder::Finish() {
+  for (size_t i = 0; i < level_; ++i) {
+    tail_[i]->SetSpan(i, size_ - tail_rank_[i]);
   }
-  prev_ = nullptr;
+  /* nodes under a head of their own are published by PublishNodes */
+  if (head_ != skiplist_->head_) return;
+  skiplist_->tail_.store(tail_[0], std::memory_order_release);
+  skiplist_->level_.store(level_, std::memory_order_relaxed);
+  skiplist_->size_.store(size_, std::memory_order_relaxed);
 }
 
-template <typename Key, typename Comparator>
-Skiplist<Key, Comparator>::SkiplistNode::~SkiplistNode() {
-  Reset();
+/* reset the first `level` levels and the backward pointer */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode::Reset(size_t level) {
+  for (size_t i = 0; i < level; ++i) {
+    InitLevel(i);
+  }
+  prev_ = nullptr;
 }
 
-/* Iterator */
-template <typename Key, typename Comparator>
-class Skiplist<Key, Comparator>::Iterator {
+/*
+ * Iterator
+ *
+ * A standard bidirectional iterator over the keys. The end iterator points past the last node,
+ * and decrementing it moves to the last node.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+class Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator {
  public:
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = Key;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const Key*;
+  using reference = const Key&;
+
+  Iterator();
   explicit Iterator(const Skiplist* skiplist);
   explicit Iterator(const Skiplist* skiplist, const SkiplistNode* node);
   Iterator(const Iterator& it);
   void SeekToFirst();
   void SeekToLast();
+  void Seek(const Key& key) { Seek<Key>(key); }
+  template <typename K, typename = LookupKey<K>>
+  void Seek(const K& key);
   Iterator& operator=(const Iterator& it);
-  void operator--();
-  void operator++();
-  bool operator==(const Iterator& it);
-  bool operator!=(const Iterator& it);
-  const Key& operator*();
+  Iterator& operator--();
+  Iterator& operator++();
+  Iterator operator--(int);
+  Iterator operator++(int);
+  bool operator==(const Iterator& it) const;
+  bool operator!=(const Iterator& it) const;
+  const Key& operator*() const;
+  const Key* operator->() const;
 
  private:
   const SkiplistNode* node_;
   const Skiplist* skiplist_;
+  /* with concurrent reads, nodes reachable from the iterator are not freed while it is alive */
+  EpochGuard guard_;
 };
 
-template <typename Key, typename Comparator>
-Skiplist<Key, Comparator>::Iterator::Iterator(const Skiplist* skiplist)
-    : skiplist_(skiplist), node_(nullptr) {}
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::Iterator()
+    : node_(nullptr), skiplist_(nullptr), guard_(false) {}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::Iterator(const Skiplist* skiplist)
+    : node_(nullptr), skiplist_(skiplist), guard_(skiplist->concurrent_reads_) {}
 
-template <typename Key, typename Comparator>
-Skiplist<Key, Comparator>::Iterator::Iterator(const Skiplist* skiplist, const SkiplistNode* node)
-    : skiplist_(skiplist), node_(node) {}
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::Iterator(const Skiplist* skiplist,
+                                                                      const SkiplistNode* node)
+    : node_(node), skiplist_(skiplist), guard_(skiplist->concurrent_reads_) {}
 
-template <typename Key, typename Comparator>
-Skiplist<Key, Comparator>::Iterator::Iterator(const Iterator& it)
-    : skiplist_(it.skiplist_), node_(it.node_) {}
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::Iterator(const Iterator& it)
+    : node_(it.node_), skiplist_(it.skiplist_), guard_(it.guard_) {}
 
-template <typename Key, typename Comparator>
-void Skiplist<Key, Comparator>::Iterator::SeekToFirst() {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::SeekToFirst() {
   node_ = skiplist_->head_->GetNext(0);
 }
 
-template <typename Key, typename Comparator>
-void Skiplist<Key, Comparator>::Iterator::SeekToLast() {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::SeekToLast() {
   node_ = skiplist_->FindLast();
   if (node_ == skiplist_->head_) node_ = nullptr;
 }
 
-template <typename Key, typename Comparator>
-typename Skiplist<Key, Comparator>::Iterator& Skiplist<Key, Comparator>::Iterator::operator=(
-    const Iterator& it) {
+/* move to the first key not less than the given key */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::Seek(const K& key) {
+  node_ = skiplist_->GetFirstElementGt(key, true);
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator&
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::operator=(const Iterator& it) {
+  guard_ = it.guard_;
   skiplist_ = it.skiplist_;
-  node_ = it.node__;
+  node_ = it.node_;
   return *this;
 }
 
-template <typename Key, typename Comparator>
-void Skiplist<Key, Comparator>::Iterator::operator++() {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator&
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::operator++() {
   node_ = node_->GetNext(0);
+  return *this;
 }
 
-template <typename Key, typename Comparator>
-void Skiplist<Key, Comparator>::Iterator::operator--() {
-  node_ = node_->GetPrev();
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator&
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::operator--() {
+  if (node_) {
+    node_ = node_->GetPrev();
+  } else {
+    SeekToLast();
+  }
+  return *this;
 }
 
-template <typename Key, typename Comparator>
-bool Skiplist<Key, Comparator>::Iterator::operator==(const Iterator& it) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::operator++(int) {
+  Iterator it(*this);
+  ++(*this);
+  return it;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::operator--(int) {
+  Iterator it(*this);
+  --(*this);
+  return it;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+bool
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::operator==(const Iterator& it) const {
   return skiplist_ == it.skiplist_ && node_ == it.node_;
 }
 
-template <typename Key, typename Comparator>
-bool Skiplist<Key, Comparator>::Iterator::operator!=(const Iterator& it) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+bool
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::operator!=(const Iterator& it) const {
   return !((*this) == it);
 }
 
-template <typename Key, typename Comparator>
-const Key& Skiplist<Key, Comparator>::Iterator::operator*() {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+const Key& Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::operator*() const {
   return node_->key_;
 }
 
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+const Key* Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator::operator->() const {
+  return &node_->key_;
+}
+
+/*
+ * View
+ *
+ * A lazy range of `size` consecutive keys starting at a node, walked forward, or backward through
+ * the backward pointers if Reverse is set. Keys are read from the nodes as the view is iterated
+ * instead of being copied. begin() and end() follow the standard naming so that views work with
+ * range-based for loops.
+ *
+ * Iterators count the keys left instead of comparing against an end node, so that with
+ * concurrent reads a view never walks past the end of the skiplist even if the writer deletes
+ * nodes in the meantime. The nodes are not freed while the view is alive, and iterators must not
+ * outlive their view.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <bool Reverse>
+class Skiplist<Key, Comparator, Allocator, LevelPolicy>::View {
+ public:
+  class Iterator;
+  explicit View(const Skiplist* skiplist, const SkiplistNode* node, size_t size);
+  Iterator begin() const { return Iterator(node_, head_, size_); }
+  Iterator end() const { return Iterator(nullptr, head_, 0); }
+  size_t Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+
+ private:
+  const SkiplistNode* node_;
+  const SkiplistNode* head_;
+  size_t size_;
+  EpochGuard guard_;
+};
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <bool Reverse>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::View<Reverse>::View(const Skiplist* skiplist,
+                                                                       const SkiplistNode* node,
+                                                                       size_t size)
+    : node_(node),
+      head_(skiplist->head_),
+      size_(node ? size : 0),
+      guard_(skiplist->concurrent_reads_) {}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <bool Reverse>
+class Skiplist<Key, Comparator, Allocator, LevelPolicy>::View<Reverse>::Iterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Key;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const Key*;
+  using reference = const Key&;
+
+  Iterator() : node_(nullptr), head_(nullptr), remaining_(0) {}
+  explicit Iterator(const SkiplistNode* node, const SkiplistNode* head, size_t remaining)
+      : node_(node), head_(head), remaining_(remaining) {}
+  Iterator& operator++();
+  Iterator operator++(int);
+  bool operator==(const Iterator& it) const { return remaining_ == it.remaining_; }
+  bool operator!=(const Iterator& it) const { return remaining_ != it.remaining_; }
+  const Key& operator*() const { return node_->key_; }
+  const Key* operator->() const { return &node_->key_; }
+
+ private:
+  const SkiplistNode* node_;
+  const SkiplistNode* head_;
+  size_t remaining_;
+};
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <bool Reverse>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::template View<Reverse>::Iterator&
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::View<Reverse>::Iterator::operator++() {
+  node_ = Reverse ? node_->GetPrev() : node_->GetNext(0);
+  /* the view may end early if the writer deleted nodes since it was created */
+  if (--remaining_ == 0 || !node_ || node_ == head_) {
+    remaining_ = 0;
+  }
+  return *this;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <bool Reverse>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::template View<Reverse>::Iterator
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::View<Reverse>::Iterator::operator++(int) {
+  Iterator it(*this);
+  ++(*this);
+  return it;
+}
+
 /* Skiplist */
-template <typename Key, typename Comparator>
-Skiplist<Key, Comparator>::Skiplist()
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Skiplist()
     : level_(InitSkiplistLevel),
-      head_(SkiplistNode::CreateSkiplistNode(InitSkiplistLevel)),
+      head_(SkiplistNode::CreateSkiplistNode(allocator_, MaxSkiplistLevel)),
+      tail_(head_),
       compare_(default_compare<Key>),
-      size_(0){};
-
-template <typename Key, typename Comparator>
-Skiplist<Key, Comparator>::Skiplist(const size_t level)
-    : level_(level),
-      head_(SkiplistNode::CreateSkiplistNode(level)),
+      size_(0),
+      concurrent_reads_(false),
+      duplicates_(false),
+      index_(nullptr){};
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Skiplist(const size_t level)
+    : level_(std::min<size_t>(level, MaxSkiplistLevel)),
+      head_(SkiplistNode::CreateSkiplistNode(allocator_, MaxSkiplistLevel)),
+      tail_(head_),
       compare_(default_compare<Key>),
-      size_(0){};
+      size_(0),
+      concurrent_reads_(false),
+      duplicates_(false),
+      index_(nullptr){};
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Skiplist(const size_t level,
+                                                            const Comparator& compare_)
+    : level_(std::min<size_t>(level, MaxSkiplistLevel)),
+      head_(SkiplistNode::CreateSkiplistNode(allocator_, MaxSkiplistLevel)),
+      tail_(head_),
+      compare_(compare_),
+      size_(0),
+      concurrent_reads_(false),
+      duplicates_(false),
+      index_(nullptr){};
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Skiplist(const size_t level,
+                                                            const Comparator& compare_,
+                                                            const LevelPolicy& level_policy)
+    : level_(std::min<size_t>(level, MaxSkiplistLevel)),
+      level_policy_(level_policy),
+      head_(SkiplistNode::CreateSkiplistNode(allocator_, MaxSkiplistLevel)),
+      tail_(head_),
+      compare_(compare_),
+      size_(0),
+      concurrent_reads_(false),
+      duplicates_(false),
+      index_(nullptr){};
+
+/*
+ * take over the nodes and the allocator of the skiplist, which is left empty with a new head.
+ * like every other write, moving must not race with readers of either skiplist.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Skiplist(Skiplist&& skiplist)
+    : level_policy_(skiplist.level_policy_),
+      head_(nullptr),
+      tail_(nullptr),
+      compare_(skiplist.compare_),
+      level_(InitSkiplistLevel),
+      size_(0),
+      concurrent_reads_(false),
+      duplicates_(false),
+      index_(nullptr) {
+  MoveFrom(skiplist);
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>&
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::operator=(Skiplist&& skiplist) {
+  if (this == &skiplist) return *this;
+
+  DropSearchIndex();
+  ReclaimNodes(true);
+  FreeNodes();
+  level_policy_ = skiplist.level_policy_;
+  AssignComparator(skiplist.compare_,
+                   std::is_copy_assignable<typename std::remove_const<Comparator>::type>());
+  MoveFrom(skiplist);
+  return *this;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Begin() const {
+  /* enter the critical section before the first node is read */
+  Iterator it(this);
+  it.SeekToFirst();
+  return it;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::End() const {
+  return Iterator(this);
+}
+
+/* return an iterator to the first key not less than the given key */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::LowerBound(const K& key) const {
+  EpochGuard guard(concurrent_reads_);
+  return Iterator(this, GetFirstElementGt(key, true));
+}
+
+/* return an iterator to the first key greater than the given key */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::Iterator
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::UpperBound(const K& key) const {
+  EpochGuard guard(concurrent_reads_);
+  return Iterator(this, GetFirstElementGt(key, false));
+}
+
+/*
+ * let any number of threads read the skiplist while a single thread writes to it, without locks.
+ * deleted nodes are freed only once no reader can still be reading them, and keys are never
+ * modified in place. Iterators stay inside an epoch critical section for their lifetime, but
+ * keys returned by reference are only safe to use while the reader holds an EpochGuard. Ranks
+ * read while the writer is modifying the skiplist may be slightly stale.
+ * must be called before the skiplist is shared with readers.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::EnableConcurrentReads() {
+  concurrent_reads_ = true;
+}
+
+/*
+ * move the keys not less than the key into a new skiplist and return it, like SplitAtRank.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::SplitAt(const K& key) {
+  size_t rank = 0;
+  GetFirstElementGt(key, true, &rank);
+  return SplitAtRank(rank);
+}
+
+/*
+ * move the keys ranked `rank` and after into a new skiplist and return it, keeping the first
+ * `rank` keys. the nodes are not copied: in each level, the last node kept is cut from the next
+ * one, which the head of the new skiplist links to instead, so only the spans along the boundary
+ * change and the split costs O(log n).
+ * the new skiplist gets the comparator, the level policy and the modes of this one.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::SplitAtRank(size_t rank) {
+  static_assert(Allocator::Interchangeable,
+                "nodes can only move between skiplists if any allocator can free them");
+  Skiplist skiplist(level_, compare_, level_policy_);
+  skiplist.concurrent_reads_ = concurrent_reads_;
+  skiplist.duplicates_.store(duplicates_, std::memory_order_relaxed);
+  if (rank >= size_) return skiplist;
+
+  DropSearchIndex();
+  SkiplistNode* node = head_;
+  size_t position = 0;
+  for (int i = level_ - 1; i >= 0; --i) {
+    while (node->GetNext(i) && position + node->GetSpan(i) <= rank) {
+      position += node->GetSpan(i);
+      node = node->GetNext(i);
+    }
+    /* node is the last node kept in level i, it spans to the end of the skiplist */
+    skiplist.head_->SetNext(i, node->GetNext(i));
+    skiplist.head_->SetSpan(i, position + node->GetSpan(i) - rank);
+    node->SetNext(i, nullptr);
+    node->SetSpan(i, rank - position);
+  }
+
+  SkiplistNode* first = skiplist.head_->GetNext(0);
+  first->SetPrev(skiplist.head_);
+  skiplist.tail_.store(tail_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  skiplist.size_.store(size_ - rank, std::memory_order_relaxed);
+  tail_.store(node, std::memory_order_release);
+  size_.store(rank, std::memory_order_relaxed);
+  return skiplist;
+}
+
+/*
+ * append the keys of the skiplist, which is left empty. its keys must all be greater than the
+ * keys of this skiplist, or not less than them with duplicates, otherwise std::invalid_argument
+ * is thrown and neither skiplist is changed.
+ * like SplitAtRank, the nodes are relinked instead of copied: the last node of each level is
+ * linked to the first node of the same level in the skiplist, which costs O(log n).
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::Concat(Skiplist& skiplist) {
+  static_assert(Allocator::Interchangeable,
+                "nodes can only move between skiplists if any allocator can free them");
+  if (this == &skiplist || skiplist.size_ == 0) return;
+  if (size_ > 0) {
+    int cmp = compare_(FindLast()->key_, skiplist.head_->GetNext(0)->key_);
+    if (cmp > 0 || (cmp == 0 && !duplicates_)) {
+      throw std::invalid_argument("skiplist concat input overlaps the skiplist");
+    }
+  }
+
+  DropSearchIndex();
+  skiplist.DropSearchIndex();
+  ExpandLevel(skiplist.level_);
+  SkiplistNode* node = head_;
+  size_t position = 0;
+  for (int i = level_ - 1; i >= 0; --i) {
+    while (node->GetNext(i)) {
+      position += node->GetSpan(i);
+      node = node->GetNext(i);
+    }
+    /* the head of the skiplist spans its first node in level i, or all of its nodes */
+    const bool linked = static_cast<size_t>(i) < skiplist.level_;
+    size_t span = linked ? skiplist.head_->GetSpan(i) : skiplist.Size();
+    node->SetSpan(i, size_ - position + span);
+    if (linked) node->SetNext(i, skiplist.head_->GetNext(i));
+  }
+
+  skiplist.head_->GetNext(0)->SetPrev(node);
+  tail_.store(skiplist.tail_.load(std::memory_order_relaxed), std::memory_order_release);
+  size_.store(size_ + skiplist.size_, std::memory_order_relaxed);
+
+  skiplist.head_->Reset(MaxSkiplistLevel);
+  skiplist.tail_.store(skiplist.head_, std::memory_order_release);
+  skiplist.level_.store(InitSkiplistLevel, std::memory_order_relaxed);
+  skiplist.size_.store(0, std::memory_order_relaxed);
+}
+
+/*
+ * merge the keys of both skiplists into a new one in a single pass over level 0, keeping the keys
+ * found only in this skiplist if `Left` is set, in both if `Both` is set, and only in the other
+ * one if `Right` is set. keys are appended with a Builder, so the result is built in O(n + m).
+ * equal keys are matched one to one like in std::set_union, std::set_intersection and
+ * std::set_difference. the new skiplist gets the comparator, the level policy and the modes of
+ * this one.
+ * keys of a skiplist that are not kept need not be visited one by one: if the skiplist is more
+ * than GallopRatio times larger than the other, a run of them is skipped with SkipTo instead, so
+ * that intersecting with a small skiplist costs O(m log(n / m)).
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <bool Left, bool Both, bool Right>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Merge(const Skiplist& skiplist) const {
+  EpochGuard guard(concurrent_reads_ || skiplist.concurrent_reads_);
+  Skiplist result(InitSkiplistLevel, compare_, level_policy_);
+  result.concurrent_reads_ = concurrent_reads_;
+  result.duplicates_.store(duplicates_, std::memory_order_relaxed);
+  Builder builder(&result, false);
+
+  const bool skip_left = !Left && size_ > GallopRatio * skiplist.size_;
+  const bool skip_right = !Right && skiplist.size_ > GallopRatio * size_;
+  const SkiplistNode* left = head_->GetNext(0);
+  const SkiplistNode* right = skiplist.head_->GetNext(0);
+  try {
+    while (left && right) {
+      int cmp = compare_(left->key_, right->key_);
+      if (cmp < 0) {
+        if (Left) builder.Append(left->key_);
+        left = skip_left ? SkipTo(left, right->key_) : left->GetNext(0);
+      } else if (cmp > 0) {
+        if (Right) builder.Append(right->key_);
+        right = skip_right ? SkipTo(right, left->key_) : right->GetNext(0);
+      } else {
+        if (Both) builder.Append(left->key_);
+        left = left->GetNext(0);
+        right = right->GetNext(0);
+      }
+    }
+    for (; Left && left; left = left->GetNext(0)) {
+      builder.Append(left->key_);
+    }
+    for (; Right && right; right = right->GetNext(0)) {
+      builder.Append(right->key_);
+    }
+  } catch (...) {
+    builder.Finish();
+    throw;
+  }
+  builder.Finish();
+  return result;
+}
+
+/*
+ * combine this skiplist with the skiplists into a new one, keeping the keys found in any of them
+ * or, if `Intersect` is set, in all of them. the result is a set, equal keys are kept once.
+ * the key space is cut into up to `threads` partitions (the number of hardware threads if 0) at
+ * keys sampled from the upper levels of every skiplist. each partition is combined by its own
+ * thread into its own skiplist, and the partial skiplists are concatenated in order in O(log n)
+ * each, or copied into the result in O(n) if the allocator is not interchangeable, like Arena.
+ * none of the skiplists may be written to meanwhile, but concurrent readers are fine.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <bool Intersect>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::CombineMany(
+    const std::vector<const Skiplist*>& skiplists, size_t threads) const {
+  std::vector<const Skiplist*> all(1, this);
+  all.insert(all.end(), skiplists.begin(), skiplists.end());
+  size_t total = 0;
+  for (const Skiplist* skiplist : all) {
+    total += skiplist->size_;
+  }
+
+  std::vector<const Key*> splitters = Splitters(all, Partitions(total, threads));
+  std::vector<Skiplist> results;
+  results.reserve(splitters.size() + 1);
+  for (size_t i = 0; i <= splitters.size(); ++i) {
+    results.push_back(Skiplist(
+        InitSkiplistLevel, compare_,
+        PartitionPolicy(level_policy_, i, std::is_constructible<LevelPolicy, uint64_t>())));
+  }
+  RunParallel(results.size(), [&](size_t i) {
+    const Key* lower = i > 0 ? splitters[i - 1] : nullptr;
+    const Key* upper = i < splitters.size() ? splitters[i] : nullptr;
+    CombineRange<Intersect>(all, lower, upper, &results[i]);
+  });
+
+  Skiplist result(InitSkiplistLevel, compare_, level_policy_);
+  result.ConcatPartitions(results, std::integral_constant<bool, Allocator::Interchangeable>());
+  result.concurrent_reads_ = concurrent_reads_;
+  return result;
+}
+
+/*
+ * the level policy of a partition of CombineMany, seeded from the partition's index if the policy
+ * can be seeded. copies of the same policy would draw the same levels in every partition, which
+ * would repeat once per partition in the concatenated skiplist.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+LevelPolicy Skiplist<Key, Comparator, Allocator, LevelPolicy>::PartitionPolicy(
+    const LevelPolicy&, size_t partition, std::true_type) {
+  return LevelPolicy(static_cast<uint64_t>(partition));
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+LevelPolicy Skiplist<Key, Comparator, Allocator, LevelPolicy>::PartitionPolicy(
+    const LevelPolicy& level_policy, size_t, std::false_type) {
+  return level_policy;
+}
+
+/* append the partial skiplists of CombineMany, in order, to this empty skiplist */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::ConcatPartitions(
+    std::vector<Skiplist>& partitions, std::true_type) {
+  for (Skiplist& partition : partitions) {
+    Concat(partition);
+  }
+}
+
+/* nodes cannot move between arenas, so the keys are moved into nodes of this skiplist instead */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::ConcatPartitions(
+    std::vector<Skiplist>& partitions, std::false_type) {
+  Builder builder(this, false);
+  try {
+    for (Skiplist& partition : partitions) {
+      for (SkiplistNode* node = partition.head_->GetNext(0); node; node = node->GetNext(0)) {
+        builder.Append(std::move(node->key_));
+      }
+    }
+  } catch (...) {
+    builder.Finish();
+    throw;
+  }
+  builder.Finish();
+}
+
+/*
+ * combine the keys within [lower, upper) of the skiplists into the empty result, where a null
+ * bound is unbounded. keys are merged through a heap of the current node of each skiplist, or
+ * intersected by leapfrogging: each skiplist in turn skips to the largest key seen so far, until
+ * all of them agree on it.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <bool Intersect>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::CombineRange(
+    const std::vector<const Skiplist*>& skiplists, const Key* lower, const Key* upper,
+    Skiplist* result) const {
+  bool concurrent_reads = false;
+  for (const Skiplist* skiplist : skiplists) {
+    concurrent_reads = concurrent_reads || skiplist->concurrent_reads_;
+  }
+  EpochGuard guard(concurrent_reads);
+
+  auto in_range = [&](const SkiplistNode* node) {
+    return node && (!upper || compare_(node->key_, *upper) < 0);
+  };
+  std::vector<const SkiplistNode*> nodes;
+  for (const Skiplist* skiplist : skiplists) {
+    nodes.push_back(lower ? skiplist->GetFirstElementGt(*lower, true)
+                          : skiplist->head_->GetNext(0));
+  }
+
+  Builder builder(result, false);
+  auto append = [&](const Key& key) {
+    if (builder.Size() == 0 || compare_(builder.Last()->key_, key) < 0) builder.Append(key);
+  };
+  try {
+    if (Intersect) {
+      for (const SkiplistNode* node : nodes) {
+        if (!in_range(node)) {
+          builder.Finish();
+          return;
+        }
+      }
+      const Key* candidate = &nodes[0]->key_;
+      /* the number of skiplists in a row whose node holds the candidate key */
+      size_t matched = 0;
+      for (size_t i = 0;; i = (i + 1) % nodes.size()) {
+        const SkiplistNode* node = nodes[i];
+        if (compare_(node->key_, *candidate) < 0) node = SkipTo(node, *candidate);
+        if (!in_range(node)) break;
+        if (compare_(node->key_, *candidate) > 0) {
+          candidate = &node->key_;
+          matched = 1;
+        } else if (++matched == nodes.size()) {
+          append(*candidate);
+          node = node->GetNext(0);
+          if (!in_range(node)) break;
+          candidate = &node->key_;
+          matched = 1;
+        }
+        nodes[i] = node;
+      }
+    } else {
+      auto greater = [this](const SkiplistNode* n1, const SkiplistNode* n2) {
+        return compare_(n1->key_, n2->key_) > 0;
+      };
+      std::vector<const SkiplistNode*> heap;
+      for (const SkiplistNode* node : nodes) {
+        if (in_range(node)) heap.push_back(node);
+      }
+      std::make_heap(heap.begin(), heap.end(), greater);
+      while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        const SkiplistNode* node = heap.back();
+        append(node->key_);
+        heap.back() = node->GetNext(0);
+        if (in_range(heap.back())) {
+          std::push_heap(heap.begin(), heap.end(), greater);
+        } else {
+          heap.pop_back();
+        }
+      }
+    }
+  } catch (...) {
+    builder.Finish();
+    throw;
+  }
+  builder.Finish();
+}
+
+/*
+ * return up to `partitions` - 1 distinct keys in ascending order, cutting the keys of the
+ * skiplists into partitions of similar sizes. the samples are the nodes of the highest level of
+ * each skiplist holding at least SamplesPerPartition nodes per partition, which are spread evenly
+ * over the skiplist like its levels are.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+std::vector<const Key*> Skiplist<Key, Comparator, Allocator, LevelPolicy>::Splitters(
+    const std::vector<const Skiplist*>& skiplists, size_t partitions) const {
+  if (partitions <= 1) return {};
+
+  std::vector<const Key*> samples;
+  for (const Skiplist* skiplist : skiplists) {
+    std::vector<const Key*> level_samples;
+    for (int i = skiplist->level_ - 1; i >= 0; --i) {
+      level_samples.clear();
+      for (const SkiplistNode* node = skiplist->head_->GetNext(i); node; node = node->GetNext(i)) {
+        level_samples.push_back(&node->key_);
+      }
+      if (level_samples.size() >= partitions * SamplesPerPartition) break;
+    }
+    samples.insert(samples.end(), level_samples.begin(), level_samples.end());
+  }
+  std::sort(samples.begin(), samples.end(),
+            [this](const Key* k1, const Key* k2) { return compare_(*k1, *k2) < 0; });
+
+  std::vector<const Key*> splitters;
+  for (size_t i = 1; i < partitions; ++i) {
+    const Key* splitter = samples[samples.size() * i / partitions];
+    if (splitters.empty() || compare_(*splitters.back(), *splitter) < 0) {
+      splitters.push_back(splitter);
+    }
+  }
+  return splitters;
+}
+
+/* return how many partitions `count` keys are split into for `threads` threads, hardware if 0 */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+size_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::Partitions(size_t count, size_t threads) {
+  if (threads == 0) threads = std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+  return std::max<size_t>(std::min(threads, count / MinPartitionSize), 1);
+}
+
+/*
+ * run task(i) for every i in [0, tasks), each on its own thread, the first one on the calling
+ * thread. the first exception thrown by a task is rethrown once all of them are done.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename Task>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::RunParallel(size_t tasks, Task task) {
+  std::vector<std::exception_ptr> errors(tasks);
+  auto run = [&task, &errors](size_t i) {
+    try {
+      task(i);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < tasks; ++i) {
+    workers.emplace_back(run, i);
+  }
+  if (tasks > 0) run(0);
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  for (const std::exception_ptr& error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+}
 
-template <typename Key, typename Comparator>
-Skiplist<Key, Comparator>::Skiplist(const size_t level, const Comparator& compare_)
-    : level_(level), head_(SkiplistNode::CreateSkiplistNode(level)), compare_(compare_), size_(0){};
+/*
+ * return the first node not less than the key, starting from a node less than the key.
+ * the search moves forward along the top level of the current node for as long as it stays
+ * before the key, reaching taller nodes as it goes, and then descends. like MoveFinger, this
+ * costs O(log d) for a distance of d nodes.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+const typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode*
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkipTo(const SkiplistNode* node,
+                                                          const Key& key) const {
+  for (;;) {
+    const SkiplistNode* next = node->GetNext(node->GetLevel() - 1);
+    if (!next || compare_(next->key_, key) >= 0) break;
+    node = next;
+  }
+  /* the first node known to be not less than the key, which needs no comparison again */
+  const SkiplistNode* bound = nullptr;
+  for (int i = node->GetLevel() - 1; i >= 0; --i) {
+    const SkiplistNode* next = node->GetNext(i);
+    while (next && next != bound && compare_(next->key_, key) < 0) {
+      node = next;
+      next = node->GetNext(i);
+    }
+    bound = next;
+  }
+  return node->GetNext(0);
+}
 
-template <typename Key, typename Comparator>
-typename Skiplist<Key, Comparator>::Iterator Skiplist<Key, Comparator>::Begin() const {
-  return Iterator(this, head_->GetNext(0));
+/*
+ * write the keys to the stream in the snapshot format of snapshot.h, encoded by the codec, with a
+ * checksum if `checksum` is set. throw std::runtime_error if the stream fails.
+ * with concurrent reads, a reader thread may save while keys are written: the snapshot then holds
+ * the keys of level 0 as the walk passed them, and stays well-formed since the records are
+ * counted as they are written.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename Codec>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::SaveSnapshot(std::ostream& out,
+                                                                     bool checksum,
+                                                                     const Codec& codec) const {
+  EpochGuard guard(concurrent_reads_);
+  uint32_t flags = (checksum ? SnapshotWriter::Checksum : 0) |
+                   (duplicates_ ? SnapshotWriter::Duplicates : 0);
+  SnapshotWriter writer(out, flags);
+  std::string bytes;
+  for (const SkiplistNode* node = head_->GetNext(0); node; node = node->GetNext(0)) {
+    bytes.clear();
+    codec.Encode(node->key_, &bytes);
+    writer.WriteKey(bytes);
+  }
+  writer.Finish();
 }
 
-template <typename Key, typename Comparator>
-typename Skiplist<Key, Comparator>::Iterator Skiplist<Key, Comparator>::End() const {
-  return Iterator(this, FindLast()->GetNext(0));
+/*
+ * replace the keys with the keys of a snapshot written by SaveSnapshot, decoded by the codec.
+ * the keys are already sorted, so they are built into new nodes in O(n) like in BulkLoad, which
+ * replace the keys only once the whole snapshot is read. duplicates are enabled if the snapshot
+ * holds equal keys.
+ * with concurrent reads, the new nodes are built under a head of their own and then published
+ * under the head, so that each reader sees either the old keys or the new ones, and never a
+ * partly built skiplist.
+ * throw std::invalid_argument and leave the skiplist unchanged if the snapshot is malformed,
+ * truncated, out of order, or does not match its checksum.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename Codec>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::LoadSnapshot(std::istream& in,
+                                                                     const Codec& codec) {
+  if (concurrent_reads_) {
+    SkiplistNode* head = SkiplistNode::CreateSkiplistNode(allocator_, MaxSkiplistLevel);
+    Builder builder(this, head);
+    bool duplicates;
+    try {
+      duplicates = ReadSnapshot(in, codec, &builder);
+    } catch (...) {
+      /* the nodes were never published, so no reader can be reading them */
+      while (head) {
+        SkiplistNode* next = head->GetNext(0);
+        SkiplistNode::DestroySkiplistNode(allocator_, head);
+        head = next;
+      }
+      throw;
+    }
+    builder.Finish();
+    /* a skiplist with duplicates enabled is also correct for the old keys */
+    if (duplicates) duplicates_.store(true, std::memory_order_relaxed);
+    PublishNodes(head, builder);
+    return;
+  }
+
+  Skiplist loaded(InitSkiplistLevel, compare_, level_policy_);
+  {
+    Builder builder(&loaded, false);
+    try {
+      loaded.duplicates_.store(ReadSnapshot(in, codec, &builder), std::memory_order_relaxed);
+    } catch (...) {
+      builder.Finish();
+      throw;
+    }
+    builder.Finish();
+  }
+  *this = std::move(loaded);
+}
+
+/*
+ * append the keys of a snapshot to the builder, and return whether the skiplist needs duplicates
+ * enabled for them. throw std::invalid_argument like LoadSnapshot.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename Codec>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::ReadSnapshot(std::istream& in,
+                                                                     const Codec& codec,
+                                                                     Builder* builder) const {
+  SnapshotReader reader(in);
+  const bool duplicates = duplicates_ || (reader.Flags() & SnapshotWriter::Duplicates);
+  while (const std::string* bytes = reader.ReadKey()) {
+    Key key = codec.Decode(bytes->data(), bytes->size());
+    if (builder->Size() > 0) {
+      int cmp = compare_(builder->Last()->key_, key);
+      if (cmp > 0 || (cmp == 0 && !duplicates)) {
+        throw std::invalid_argument("skiplist snapshot keys are not sorted");
+      }
+    }
+    builder->Append(std::move(key));
+  }
+  reader.Finish();
+  return duplicates;
+}
+
+/*
+ * replace the nodes with the nodes built under `head` by the builder, while readers may still be
+ * reading the current ones, which are retired.
+ * the levels of the head are pointed at the new nodes from level 0 up: a reader moving right from
+ * the head stays among the nodes it moved to, and a reader that sees the new nodes in a level
+ * sees them in every level below, so each reader finds either the old keys or the new ones.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::PublishNodes(SkiplistNode* head,
+                                                                     const Builder& builder) {
+  DropSearchIndex();
+  SkiplistNode* old = head_->GetNext(0);
+  const size_t old_size = size_;
+  const size_t level = std::max<size_t>(builder.Level(), level_);
+
+  SkiplistNode* first = head->GetNext(0);
+  if (first) first->SetPrev(head_);
+  for (size_t i = 0; i < level; ++i) {
+    head_->SetSpan(i, head->GetSpan(i));
+    head_->SetNext(i, head->GetNext(i));
+  }
+  const SkiplistNode* tail = first ? builder.Last() : head_;
+  tail_.store(const_cast<SkiplistNode*>(tail), std::memory_order_release);
+  level_.store(builder.Level(), std::memory_order_relaxed);
+  size_.store(builder.Size(), std::memory_order_relaxed);
+
+  SkiplistNode::DestroySkiplistNode(allocator_, head);
+  if (old) RetireNode(old, old_size);
+}
+
+/*
+ * let the skiplist hold equal keys, like a multiset. a key equal to existing keys is inserted
+ * after them, so equal keys stay in insertion order, and an updated key moves behind the keys
+ * equal to its new value. Delete, Update and GetRankofElement act on the first of the equal keys.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::EnableDuplicates() {
+  duplicates_.store(true, std::memory_order_relaxed);
+}
+
+/*
+ * pack the upper levels into a read-optimized search index, which lookups by key and by rank use
+ * to skip the upper levels. the comparator must provide key prefixes, and the index works best if
+ * most prefixes are distinct, like for IntegerCompare.
+ * every write drops the index, so it should be built again once a batch of writes is done. like
+ * any write, it must be called by the writer.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::BuildSearchIndex() {
+  static_assert(CachePrefix, "the search index needs a comparator providing key prefixes");
+  std::unique_ptr<SearchIndex> index(new SearchIndex());
+  std::vector<uint64_t> prefixes, ranks;
+  size_t rank = 0;
+  const SkiplistNode* prev = head_;
+  for (const SkiplistNode* node = head_->GetNext(IndexedLevel - 1); node;
+       node = node->GetNext(IndexedLevel - 1)) {
+    rank += prev->GetSpan(IndexedLevel - 1);
+    prefixes.push_back(node->GetPrefix());
+    ranks.push_back(rank);
+    index->nodes_.push_back(node);
+    prev = node;
+  }
+  index->prefixes_ = PackedIndex(prefixes);
+  index->ranks_ = PackedIndex(ranks);
+
+  DropSearchIndex();
+  index_.store(index.release(), std::memory_order_release);
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+size_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::RandomLevel() {
+  return level_policy_.RandomLevel();
+}
+
+/* the level of the node at the 1-based `rank` in a perfectly balanced skiplist */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+size_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::BalancedLevel(size_t rank) {
+  size_t level = 1;
+  while (level < MaxSkiplistLevel && rank % LevelPolicy::Branching == 0) {
+    rank /= LevelPolicy::Branching;
+    ++level;
+  }
+  return level;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Lt(const Key& k1, const K& k2) const {
+  return compare_(k1, k2) < 0;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Lte(const Key& k1, const K& k2) const {
+  return compare_(k1, k2) <= 0;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Gt(const Key& k1, const K& k2) const {
+  return compare_(k1, k2) > 0;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Gte(const Key& k1, const K& k2) const {
+  return compare_(k1, k2) >= 0;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Eq(const Key& k1, const K& k2) const {
+  return compare_(k1, k2) == 0;
+}
+
+/* the prefix of the key if the comparator provides prefixes, 0 otherwise */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+uint64_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::KeyPrefix(const K& key) const {
+  return KeyPrefix(key, std::integral_constant<bool, CachePrefix>());
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+uint64_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::KeyPrefix(const K& key,
+                                                                      std::true_type) const {
+  return compare_.Prefix(key);
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+uint64_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::KeyPrefix(const K&,
+                                                                      std::false_type) const {
+  return 0;
+}
+
+/*
+ * three-way comparison of the node's key with a key whose prefix is `prefix`, with a single call
+ * to the comparator at most. keys with different cached prefixes are ordered by the prefixes.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+int Skiplist<Key, Comparator, Allocator, LevelPolicy>::Compare(const SkiplistNode* node,
+                                                               const K& key,
+                                                               uint64_t prefix) const {
+  if (CachePrefix && node->GetPrefix() != prefix) return node->GetPrefix() < prefix ? -1 : 1;
+  return compare_(node->key_, key);
+}
+
+/* create a node whose key is constructed from args, caching the key's prefix */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename... Args>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode*
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::CreateNode(size_t level, Args&&... args) {
+  SkiplistNode* node =
+      SkiplistNode::CreateSkiplistNode(allocator_, level, std::forward<Args>(args)...);
+  node->SetPrefix(KeyPrefix(node->key_));
+  return node;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Insert(const Key& key) {
+  return InsertNode(key) != nullptr;
+}
+
+/* the key is moved into the node only if it is inserted */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Insert(Key&& key) {
+  return InsertNode(std::move(key)) != nullptr;
+}
+
+/*
+ * construct the key in place from args and insert it. return false if the key already exists.
+ * the key has to be constructed to be compared, so it is built directly in a new node, which is
+ * freed again if the key exists.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename... Args>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Emplace(Args&&... args) {
+  size_t insert_level = RandomLevel();
+  SkiplistNode* node = CreateNode(insert_level, std::forward<Args>(args)...);
+  ExpandLevel(insert_level);
+
+  SkiplistNode* update[MaxSkiplistLevel];
+  size_t rank[MaxSkiplistLevel];
+  if (!FindInsertPosition(node->key_, update, rank)) {
+    /* the node was never linked, so no reader can see it */
+    SkiplistNode::DestroySkiplistNode(allocator_, node);
+    return false;
+  }
+
+  LinkNode(node, update, rank);
+  return true;
+}
+
+/*
+ * If the level is larger than the current level,
+ * init empty skiplist levels for the extra levels and update the level.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::ExpandLevel(size_t level) {
+  for (size_t i = level_; i < level; ++i) {
+    head_->InitLevel(i);
+    head_->SetSpan(i, size_);
+  }
+
+  if (level > level_) level_.store(level, std::memory_order_relaxed);
+}
+
+/*
+ * insert the key and return the new node, or nullptr if the key already exists.
+ * the key is copied or moved into the node only once its position is found.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode*
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::InsertNode(K&& key) {
+  size_t insert_level = RandomLevel();
+  ExpandLevel(insert_level);
+
+  SkiplistNode* update[MaxSkiplistLevel];
+  size_t rank[MaxSkiplistLevel];
+  if (!FindInsertPosition(key, update, rank)) return nullptr;
+
+  SkiplistNode* node = CreateNode(insert_level, std::forward<K>(key));
+  LinkNode(node, update, rank);
+  return node;
+}
+
+/*
+ * replace the keys of the skiplist with the keys in [first, last), which must be sorted in
+ * ascending order. duplicated keys are skipped unless duplicates are enabled.
+ * nodes are appended in a single pass, keeping the last node of each level and its rank, so the
+ * skiplist is built in O(n) with a single comparison per key instead of O(n log n) for n inserts.
+ * if `balanced` is set, the level of each node is derived from its rank and the skiplist is
+ * perfectly balanced, otherwise levels are random like in Insert.
+ * throw std::invalid_argument and leave the skiplist empty if the keys are not sorted.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename InputIt>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::BulkLoad(InputIt first, InputIt last,
+                                                                 bool balanced) {
+  Clear();
+
+  Builder builder(this, balanced);
+  bool sorted = true;
+  try {
+    for (; first != last; ++first) {
+      if (builder.Size() > 0) {
+        int cmp = compare_(builder.Last()->key_, *first);
+        if (cmp == 0 && !duplicates_) continue;
+        if (cmp > 0) {
+          sorted = false;
+          break;
+        }
+      }
+      builder.Append(*first);
+    }
+  } catch (...) {
+    builder.Finish();
+    Clear();
+    throw;
+  }
+  builder.Finish();
+
+  if (!sorted) {
+    Clear();
+    throw std::invalid_argument("skiplist bulk load input is not sorted");
+  }
+}
+
+/*
+ * Get the last node with a key less than the given key in each level, as well as its rank.
+ * return false if the key already exists. with duplicates, the last node with a key not greater
+ * than the key is returned instead, so that the key is inserted after the keys equal to it.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::FindInsertPosition(
+    const Key& key, SkiplistNode* update[MaxSkiplistLevel], size_t rank[MaxSkiplistLevel]) {
+  const uint64_t prefix = KeyPrefix(key);
+  SkiplistNode* n = head_;
+  /* the first node known to be greater than the key, which needs no comparison again */
+  const SkiplistNode* bound = nullptr;
+  for (int i = level_ - 1; i >= 0; --i) {
+    rank[i] = (i == level_ - 1) ? 0 : rank[i + 1];
+    SkiplistNode* next = n->GetNext(i);
+    while (next && next != bound) {
+      int cmp = Compare(next, key, prefix);
+      if (cmp == 0 && !duplicates_) return false;
+      if (cmp > 0) break;
+      rank[i] += n->GetSpan(i);
+      n = next;
+      next = n->GetNext(i);
+    }
+    bound = next;
+    update[i] = n;
+  }
+  return true;
+}
+
+/*
+ * link the node after update[i] in each of its levels and update span_.
+ * update and rank must come from FindInsertPosition.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::LinkNode(SkiplistNode* node,
+                                                            SkiplistNode* update[MaxSkiplistLevel],
+                                                            size_t rank[MaxSkiplistLevel]) {
+  DropSearchIndex();
+  for (size_t i = 0; i < level_; ++i) {
+    if (i < node->GetLevel()) {
+      /* need to insert the key */
+      size_t span = update[i]->GetSpan(i);
+      node->SetNext(i, update[i]->GetNext(i));
+      node->SetSpan(i, span - rank[0] + rank[i]);
+      update[i]->SetNext(i, node);
+      update[i]->SetSpan(i, rank[0] - rank[i] + 1);
+    } else {
+      /* only increase span_ by 1 */
+      update[i]->SetSpan(i, update[i]->GetSpan(i) + 1);
+    }
+  }
+
+  /* for level 0, update backward pointer since it's a double linked list */
+  node->SetPrev(update[0]);
+  if (node->GetNext(0)) {
+    node->GetNext(0)->SetPrev(node);
+  } else {
+    tail_.store(node, std::memory_order_release);
+  }
+  size_.store(size_ + 1, std::memory_order_relaxed);
+}
+
+/*
+ * insert the keys in [first, last) and return the number of keys inserted.
+ * the search path of each key is reused as a finger for the next one, so for keys sorted in
+ * ascending order a search only climbs as high as the distance to the previous key requires.
+ * keys out of order are still inserted, but their search starts from the head.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename InputIt>
+size_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::InsertBatch(InputIt first, InputIt last) {
+  SkiplistNode* update[MaxSkiplistLevel];
+  size_t rank[MaxSkiplistLevel];
+  InitFinger(update, rank);
+
+  size_t inserted = 0;
+  for (; first != last; ++first) {
+    const Key& key = *first;
+    size_t insert_level = RandomLevel();
+    ExpandLevel(insert_level);
+
+    MoveFinger(key, true, update, rank);
+    if (!duplicates_ && update[0] != head_ && Compare(update[0], key, KeyPrefix(key)) == 0) {
+      continue;
+    }
+
+    SkiplistNode* node = CreateNode(insert_level, key);
+    LinkNode(node, update, rank);
+    size_t node_rank = rank[0] + 1;
+    for (size_t i = 0; i < insert_level; ++i) {
+      update[i] = node;
+      rank[i] = node_rank;
+    }
+    ++inserted;
+  }
+  return inserted;
+}
+
+/*
+ * set update[i] to the head in every level, which is a valid finger for any key.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::InitFinger(
+    SkiplistNode* update[MaxSkiplistLevel], size_t rank[MaxSkiplistLevel]) {
+  std::fill(update, update + MaxSkiplistLevel, head_);
+  std::fill(rank, rank + MaxSkiplistLevel, 0);
+}
+
+/*
+ * move the search path in update and rank forward to the key: update[i] becomes the last node in
+ * level i with a key less than the key, or not greater than it if `inclusive` is set.
+ * the path must have been left by a smaller key. the search climbs from level 0 to the first
+ * level that does not need to move forward, since no level above it can move either, and goes
+ * down from there, which costs O(log d) for a distance of d nodes instead of O(log n).
+ * if the path is already past the key, the search starts from the head.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::MoveFinger(
+    const Key& key, bool inclusive, SkiplistNode* update[MaxSkiplistLevel],
+    size_t rank[MaxSkiplistLevel]) {
+  const uint64_t prefix = KeyPrefix(key);
+  auto before = [&](const SkiplistNode* n) {
+    if (!n) return false;
+    int cmp = Compare(n, key, prefix);
+    return inclusive ? cmp <= 0 : cmp < 0;
+  };
+
+  if (update[0] != head_ && !before(update[0])) {
+    InitFinger(update, rank);
+  }
+
+  int level = level_;
+  int top = 0;
+  while (top < level - 1 && before(update[top]->GetNext(top))) {
+    ++top;
+  }
+
+  SkiplistNode* n = update[top];
+  for (int i = top; i >= 0; --i) {
+    if (i < top) rank[i] = rank[i + 1];
+    /* load each pointer once, the writer may unlink the node in between */
+    SkiplistNode* next = n->GetNext(i);
+    while (before(next)) {
+      rank[i] += n->GetSpan(i);
+      n = next;
+      next = n->GetNext(i);
+    }
+    update[i] = n;
+  }
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Contains(const K& key) {
+  EpochGuard guard(concurrent_reads_);
+  const uint64_t prefix = KeyPrefix(key);
+  int top;
+  size_t rank;
+  const SkiplistNode* n = SearchStart(prefix, &top, &rank);
+  /* the first node known to be greater than the key, which needs no comparison again */
+  const SkiplistNode* bound = nullptr;
+
+  for (int i = top; i >= 0; --i) {
+    /* load each pointer once, the writer may unlink the node in between */
+    const SkiplistNode* next = n->GetNext(i);
+    while (next && next != bound) {
+      int cmp = Compare(next, key, prefix);
+      if (cmp == 0) return true;
+      if (cmp > 0) break;
+      n = next;
+      next = n->GetNext(i);
+    }
+    bound = next;
+  }
+
+  return false;
+}
+
+/*
+ * return whether each key in [first, last) exists.
+ * like InsertBatch, keys sorted in ascending order are searched from the previous key.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename InputIt>
+std::vector<bool>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::ContainsBatch(InputIt first, InputIt last) {
+  EpochGuard guard(concurrent_reads_);
+  SkiplistNode* update[MaxSkiplistLevel];
+  size_t rank[MaxSkiplistLevel];
+  InitFinger(update, rank);
+
+  std::vector<bool> result;
+  for (; first != last; ++first) {
+    const Key& key = *first;
+    MoveFinger(key, true, update, rank);
+    result.push_back(update[0] != head_ && Compare(update[0], key, KeyPrefix(key)) == 0);
+  }
+  return result;
+}
+
+/*
+ * return whether each key in [first, last) exists. unlike ContainsBatch, the keys need not be
+ * sorted: up to SearchGroupSize searches run interleaved, so that the cache misses of one search
+ * overlap with the steps of the others.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename ForwardIt>
+std::vector<bool>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::ContainsMany(ForwardIt first, ForwardIt last) {
+  EpochGuard guard(concurrent_reads_);
+  std::vector<bool> result(std::distance(first, last));
+  SearchMany(first, last, [&result](size_t i, ssize_t rank) { result[i] = rank >= 0; });
+  return result;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Delete(const K& key) {
+  const uint64_t prefix = KeyPrefix(key);
+  SkiplistNode* n = head_;
+  SkiplistNode* update[MaxSkiplistLevel];
+  memset(update, 0, sizeof update);
+
+  /* the first node known to be not less than the key */
+  const SkiplistNode* bound = nullptr;
+  bool exist = false;
+  for (int i = level_ - 1; i >= 0; --i) {
+    SkiplistNode* next = n->GetNext(i);
+    while (next && next != bound) {
+      int cmp = Compare(next, key, prefix);
+      if (cmp >= 0) {
+        exist = cmp == 0;
+        break;
+      }
+      n = next;
+      next = n->GetNext(i);
+    }
+    bound = next;
+    update[i] = n;
+  }
+
+  if (!exist) return false;
+
+  DeleteNode(update[0]->GetNext(0), update);
+  return true;
 }
 
-template <typename Key, typename Comparator>
-size_t Skiplist<Key, Comparator>::RandomLevel() {
-  size_t level = 1;
-  while (level < MaxSkiplistLevel && ((double)rand() / RAND_MAX) < SkiplistP) {
-    ++level;
+/*
+ * delete the keys in [first, last) and return the number of keys deleted.
+ * like InsertBatch, keys sorted in ascending order are searched from the previous key.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename InputIt>
+size_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::DeleteBatch(InputIt first, InputIt last) {
+  SkiplistNode* update[MaxSkiplistLevel];
+  size_t rank[MaxSkiplistLevel];
+  InitFinger(update, rank);
+
+  size_t deleted = 0;
+  for (; first != last; ++first) {
+    const Key& key = *first;
+    /* the path stops before the key, so it never holds the deleted node */
+    MoveFinger(key, false, update, rank);
+    SkiplistNode* node = update[0]->GetNext(0);
+    if (!node || Compare(node, key, KeyPrefix(key)) != 0) continue;
+
+    DeleteNode(node, update);
+    ++deleted;
   }
-  return level;
+  return deleted;
 }
 
-template <typename Key, typename Comparator>
-bool Skiplist<Key, Comparator>::Lt(const Key& k1, const Key& k2) {
-  return compare_(k1, k2) < 0;
+/*
+ * delete the key at the rank. negative ranks count from the back like in GetElementByRank.
+ * return false if the rank is out of bound.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::DeleteByRank(int rank) {
+  return DeleteRankRange(rank, rank) == 1;
 }
 
-template <typename Key, typename Comparator>
-bool Skiplist<Key, Comparator>::Lte(const Key& k1, const Key& k2) {
-  return Lt(k1, k2) || Eq(k1, k2);
+/*
+ * delete the keys ranked within [start, end] and return the number of keys deleted, like
+ * redis' ZREMRANGEBYRANK. negative ranks count from the back like in GetElementsByRange.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+size_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::DeleteRankRange(int start, int end) {
+  if (start < 0) {
+    start += size_;
+  }
+  if (end < 0) {
+    end += size_;
+  }
+  if (start < 0 || end < 0 || static_cast<size_t>(start) >= size_ || start > end) return 0;
+  size_t last = std::min(static_cast<size_t>(end), size_ - 1);
+  return DeleteRun(start, last - start + 1);
 }
 
-template <typename Key, typename Comparator>
-bool Skiplist<Key, Comparator>::Gt(const Key& k1, const Key& k2) {
-  return compare_(k1, k2) > 0;
+/*
+ * delete the keys within the range [start, end) and return the number of keys deleted, like
+ * redis' ZREMRANGEBYSCORE.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K1, typename K2, typename, typename>
+size_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::DeleteRange(const K1& start,
+                                                                      const K2& end) {
+  size_t start_rank = 0, end_rank = 0;
+  GetFirstElementGt(start, true, &start_rank);
+  GetFirstElementGt(end, true, &end_rank);
+  /* the range is empty if end is not greater than start */
+  if (end_rank <= start_rank) return 0;
+  return DeleteRun(start_rank, end_rank - start_rank);
 }
 
-template <typename Key, typename Comparator>
-bool Skiplist<Key, Comparator>::Gte(const Key& k1, const Key& k2) {
-  return Gt(k1, k2) || Eq(k1, k2);
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Update(const Key& key, const Key& new_key) {
+  return UpdateNode(key, [&new_key](Key& k) { k = new_key; }) != nullptr;
 }
 
-template <typename Key, typename Comparator>
-bool Skiplist<Key, Comparator>::Eq(const Key& k1, const Key& k2) {
-  return compare_(k1, k2) == 0;
+/* the new key is moved into the node if the key is found */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::Update(const Key& key, Key&& new_key) {
+  return UpdateNode(key, [&new_key](Key& k) { k = std::move(new_key); }) != nullptr;
 }
 
-template <typename Key, typename Comparator>
-bool Skiplist<Key, Comparator>::Insert(const Key& key) {
-  int insert_level = RandomLevel();
-
-  /*
-   * If random level is larger than level
-   * init empty skiplist level for extra levels and update level to the random
-   * level.
-   */
-  for (int i = level_; i < insert_level; ++i) {
-    head_->InitLevel(i);
-    head_->SetSpan(i, size_);
-  }
-
-  if (insert_level > level_) level_ = insert_level;
-
-  const SkiplistNode* update[level_];
-  size_t rank[level_];
-
-  /* Get the last key less than current key in each level */
-  const SkiplistNode* n = head_;
-  for (int i = level_ - 1; i >= 0; --i) {
-    rank[i] = (i == level_ - 1) ? 0 : rank[i + 1];
-    while (n->GetNext(i) && Lte(n->GetNext(i)->key_, key)) {
-      rank[i] += n->GetSpan(i);
-      n = n->GetNext(i);
-    }
-    if (Eq(n->key_, key)) return false;
-    update[i] = n;
-  }
+/*
+ * return the first key.
+ * throw std::out_of_range if the skiplist is empty.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+const Key& Skiplist<Key, Comparator, Allocator, LevelPolicy>::Front() {
+  const SkiplistNode* node = head_->GetNext(0);
+  if (!node) throw std::out_of_range("skiplist is empty");
+  return node->key_;
+}
 
-  SkiplistNode* node = SkiplistNode::CreateSkiplistNode(key, level_);
+/*
+ * return the last key in O(1).
+ * throw std::out_of_range if the skiplist is empty.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+const Key& Skiplist<Key, Comparator, Allocator, LevelPolicy>::Back() {
+  const SkiplistNode* node = FindLast();
+  if (node == head_) throw std::out_of_range("skiplist is empty");
+  return node->key_;
+}
 
-  /*
-   * insert the key and update span_
-   */
-  for (int i = 0; i < level_; ++i) {
-    if (i < insert_level) {
-      /* need to insert the key */
-      size_t span = update[i]->GetSpan(i);
-      node->SetNext(i, update[i]->GetNext(i));
-      node->SetSpan(i, span - rank[0] + rank[i]);
-      SkiplistNode* n = const_cast<SkiplistNode*>(update[i]);
-      n->SetNext(i, node);
-      n->SetSpan(i, rank[0] - rank[i] + 1);
-    } else {
-      /* only increase span_ by 1 */
-      SkiplistNode* n = const_cast<SkiplistNode*>(update[i]);
-      n->SetSpan(i, update[i]->GetSpan(i) + 1);
-    }
-  }
+/*
+ * delete the first key, storing it into `key` if given. return false if the skiplist is empty.
+ * the head is the predecessor of the first node in every level, so no search is needed.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::PopFront(Key* key) {
+  SkiplistNode* node = head_->GetNext(0);
+  if (!node) return false;
 
-  /* for level 0, update backward pointer since it's a double linked list */
-  node->SetPrev(update[0]);
-  if (node->GetNext(0)) {
-    node->GetNext(0)->SetPrev(node);
-  }
-  ++size_;
+  SkiplistNode* update[MaxSkiplistLevel];
+  std::fill(update, update + MaxSkiplistLevel, head_);
+  if (key) *key = node->key_;
+  DeleteNode(node, update);
   return true;
 }
 
-template <typename Key, typename Comparator>
-bool Skiplist<Key, Comparator>::Contains(const Key& key) {
-  const SkiplistNode* n = head_;
-
-  for (int i = level_ - 1; i >= 0; --i) {
-    while (n->GetNext(i) && Lt(n->GetNext(i)->key_, key)) {
-      n = n->GetNext(i);
-    }
-
-    const SkiplistNode* next = n->GetNext(i);
-    if (next && Eq(next->key_, key)) {
-      return true;
-    }
-  }
-
-  return false;
-}
+/*
+ * delete the last key, storing it into `key` if given. return false if the skiplist is empty.
+ * the last node is cached, but its predecessors in the upper levels are only reachable from the
+ * head, so they are found by following pointers down to it, without comparing any key.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+bool Skiplist<Key, Comparator, Allocator, LevelPolicy>::PopBack(Key* key) {
+  SkiplistNode* node = tail_.load(std::memory_order_relaxed);
+  if (node == head_) return false;
 
-template <typename Key, typename Comparator>
-bool Skiplist<Key, Comparator>::Delete(const Key& key) {
-  SkiplistNode* n = head_;
   SkiplistNode* update[MaxSkiplistLevel];
-  memset(update, 0, sizeof update);
-
-  bool exist = false;
+  SkiplistNode* n = head_;
   for (int i = level_ - 1; i >= 0; --i) {
-    while (n->GetNext(i) && Lt(n->GetNext(i)->key_, key)) {
+    while (n->GetNext(i) && n->GetNext(i) != node) {
       n = n->GetNext(i);
     }
-    if (n->GetNext(i) && Eq(n->GetNext(i)->key_, key)) {
-      exist = true;
-    }
     update[i] = n;
   }
-
-  if (!exist) return false;
-
-  DeleteNode(key, update);
+  if (key) *key = node->key_;
+  DeleteNode(node, update);
   return true;
 }
 
-template <typename Key, typename Comparator>
-bool Skiplist<Key, Comparator>::Update(const Key& key, const Key& new_key) {
+/*
+ * modify the key of the node containing `key` and return the node.
+ * if the key's position is not changed, the node is updated in place. otherwise it is unlinked
+ * and linked again at its new position, without being reallocated.
+ * return nullptr if the key is not found, or if the modified key already exists, in which case
+ * the node is deleted.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename Modifier>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode*
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::UpdateNode(const Key& key, Modifier modify) {
   SkiplistNode* update[MaxSkiplistLevel];
   memset(update, 0, sizeof(update));
 
+  const uint64_t prefix = KeyPrefix(key);
   SkiplistNode* node = head_;
   for (int i = level_ - 1; i >= 0; --i) {
-    while (node->GetNext(i) && Lt(node->GetNext(i)->key_, key)) {
+    while (node->GetNext(i) && Compare(node->GetNext(i), key, prefix) < 0) {
       node = node->GetNext(i);
     }
     update[i] = node;
   }
 
-  if (!update[0]->GetNext(0) || !Eq(update[0]->GetNext(0)->key_, key)) {
+  node = update[0]->GetNext(0);
+  if (!node || Compare(node, key, prefix) != 0) {
     /* key not found */
-    return false;
+    return nullptr;
   }
 
-  /* the first GetNext(0) must return a non null value since it's the node containing the
-   * original key */
-  const SkiplistNode* next_next = update[0]->GetNext(0)->GetNext(0);
-  if ((update[0] == head_ || Gte(new_key, update[0]->key_)) &&
-      (!next_next || Lte(new_key, next_next->key_))) {
-    /* if in the key's position is not changed, update the key directly */
-    SkiplistNode* next = update[0]->GetNext(0);
-    next->key_ = new_key;
-    return true;
-  } else {
-    /* otherwise, delete the original node and insert a new one */
-    DeleteNode(key, update);
-    return Insert(new_key);
+  if (concurrent_reads_) {
+    /* readers may be reading the key, so it is never changed in place */
+    Key new_key(node->key_);
+    modify(new_key);
+    DeleteNode(node, update);
+    return InsertNode(std::move(new_key));
+  }
+
+  /* `key` may refer to the node's own key, so it must not be used after this point */
+  DropSearchIndex();
+  modify(node->key_);
+  node->SetPrefix(KeyPrefix(node->key_));
+
+  const SkiplistNode* next = node->GetNext(0);
+  int prev_cmp = update[0] == head_ ? -1 : Compare(update[0], node->key_, node->GetPrefix());
+  /* with duplicates, the node may stay right after an equal key */
+  if ((prev_cmp < 0 || (duplicates_ && prev_cmp == 0)) &&
+      (!next || Compare(next, node->key_, node->GetPrefix()) > 0)) {
+    /* if in the key's position is not changed, the key is already updated */
+    return node;
+  }
+
+  /* otherwise, move the node to its new position */
+  UnlinkNode(node, update);
+  size_t rank[MaxSkiplistLevel];
+  if (!FindInsertPosition(node->key_, update, rank)) {
+    DropNode(node);
+    return nullptr;
   }
+  LinkNode(node, update, rank);
+  return node;
 }
 
-template <typename Key, typename Comparator>
-const Key& Skiplist<Key, Comparator>::GetElementByRank(int rank) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+const Key& Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementByRank(int rank) {
   if (rank < 0) {
     rank += size_;
   }
@@ -440,26 +2239,54 @@ const Key& Skiplist<Key, Comparator>::GetElementByRank(int rank) {
   return node->key_;
 }
 
-template <typename Key, typename Comparator>
-ssize_t Skiplist<Key, Comparator>::GetRankofElement(const Key& key) {
-  size_t rank = 0;
-  const SkiplistNode* node = head_;
-
-  for (int i = level_ - 1; i >= 0; --i) {
-    while (node->GetNext(i) && Lt(node->GetNext(i)->key_, key)) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+ssize_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetRankofElement(const K& key) {
+  EpochGuard guard(concurrent_reads_);
+  const uint64_t prefix = KeyPrefix(key);
+  int top;
+  size_t rank;
+  const SkiplistNode* node = SearchStart(prefix, &top, &rank);
+  /* the first node known to be not less than the key, which needs no comparison again */
+  const SkiplistNode* bound = nullptr;
+  /* with duplicates, an equal key found above level 0 may not be the first one */
+  bool found = false;
+
+  for (int i = top; i >= 0; --i) {
+    const SkiplistNode* next = node->GetNext(i);
+    while (next && next != bound) {
+      int cmp = Compare(next, key, prefix);
+      if (cmp == 0) {
+        if (!duplicates_) return rank + node->GetSpan(i) - 1;
+        found = true;
+        break;
+      }
+      if (cmp > 0) break;
       rank += node->GetSpan(i);
-      node = node->GetNext(i);
-    }
-    if (node->GetNext(i) && Eq(node->GetNext(i)->key_, key)) {
-      return rank + node->GetSpan(i) - 1;
+      node = next;
+      next = node->GetNext(i);
     }
+    bound = next;
   }
 
-  return -1;
+  /* the node after the last one less than the key is the first equal key */
+  return found ? rank : -1;
+}
+
+/* return the rank of each key in [first, last), or -1 if it does not exist, like ContainsMany */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename ForwardIt>
+std::vector<ssize_t>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::RankMany(ForwardIt first, ForwardIt last) {
+  EpochGuard guard(concurrent_reads_);
+  std::vector<ssize_t> result(std::distance(first, last));
+  SearchMany(first, last, [&result](size_t i, ssize_t rank) { result[i] = rank; });
+  return result;
 }
 
-template <typename Key, typename Comparator>
-std::vector<Key> Skiplist<Key, Comparator>::GetElementsByRange(int start, int end) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+std::vector<Key>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsByRange(int start, int end) {
   if (start < 0) {
     start += size_;
   }
@@ -470,8 +2297,29 @@ std::vector<Key> Skiplist<Key, Comparator>::GetElementsByRange(int start, int en
   return GetElements(start, end);
 }
 
-template <typename Key, typename Comparator>
-std::vector<Key> Skiplist<Key, Comparator>::GetElementsByRevRange(int start, int end) {
+/*
+ * like GetElementsByRange, copying the keys on up to `threads` threads (the number of hardware
+ * threads if 0). the range is split into runs of consecutive ranks, whose first nodes are found
+ * independently by rank.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+std::vector<Key> Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsByRange(
+    int start, int end, size_t threads) {
+  EpochGuard guard(concurrent_reads_);
+  if (start < 0) {
+    start += size_;
+  }
+  if (end < 0) {
+    end += size_;
+  }
+  if (start < 0 || end < 0 || start > end || static_cast<size_t>(start) >= size_) return {};
+  size_t last = std::min(static_cast<size_t>(end), size_ - 1);
+  return GetElementsParallel(start, last - start + 1, threads);
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+std::vector<Key>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsByRevRange(int start, int end) {
   if (start < 0) {
     start += size_;
   }
@@ -482,37 +2330,44 @@ std::vector<Key> Skiplist<Key, Comparator>::GetElementsByRevRange(int start, int
   return GetElementsRev(start, end);
 }
 
-template <typename Key, typename Comparator>
-std::vector<Key> Skiplist<Key, Comparator>::GetElementsGt(const Key& start) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+std::vector<Key> Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsGt(const K& start) {
   return GetElementsGt(start, false);
 }
 
-template <typename Key, typename Comparator>
-std::vector<Key> Skiplist<Key, Comparator>::GetElementsGte(const Key& start) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+std::vector<Key> Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsGte(const K& start) {
   return GetElementsGt(start, true);
 }
 
-template <typename Key, typename Comparator>
-std::vector<Key> Skiplist<Key, Comparator>::GetElementsLt(const Key& end) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+std::vector<Key> Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsLt(const K& end) {
   return GetElementsLt(end, false);
 }
 
-template <typename Key, typename Comparator>
-std::vector<Key> Skiplist<Key, Comparator>::GetElementsLte(const Key& end) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+std::vector<Key> Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsLte(const K& end) {
   return GetElementsLt(end, true);
 }
 
 /*
  * return all keys within the range [start, end)
  */
-template <typename Key, typename Comparator>
-std::vector<Key> Skiplist<Key, Comparator>::GetElementsInRange(const Key& start, const Key& end) {
-  if (Gte(start, end)) return {};
-
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K1, typename K2, typename, typename>
+std::vector<Key> Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsInRange(
+    const K1& start, const K2& end) {
+  EpochGuard guard(concurrent_reads_);
+  /* start and end are never compared, as only keys are comparable with a lookup type */
   const SkiplistNode* ns = GetFirstElementGt(start, true);
+  const uint64_t end_prefix = KeyPrefix(end);
 
   std::vector<Key> keys;
-  while (ns && Lt(ns->key_, end)) {
+  while (ns && Compare(ns, end, end_prefix) < 0) {
     keys.push_back(ns->key_);
     ns = ns->GetNext(0);
   }
@@ -520,8 +2375,172 @@ std::vector<Key> Skiplist<Key, Comparator>::GetElementsInRange(const Key& start,
   return keys;
 }
 
-template <typename Key, typename Comparator>
-std::vector<Key> Skiplist<Key, Comparator>::GetElementsGt(const Key& start, bool Eq) {
+/* like GetElementsInRange, copying the keys on up to `threads` threads as GetElementsByRange */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K1, typename K2, typename, typename>
+std::vector<Key> Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsInRange(
+    const K1& start, const K2& end, size_t threads) {
+  EpochGuard guard(concurrent_reads_);
+  size_t start_rank = 0, end_rank = 0;
+  GetFirstElementGt(start, true, &start_rank);
+  GetFirstElementGt(end, true, &end_rank);
+  if (end_rank <= start_rank) return {};
+  return GetElementsParallel(start_rank, end_rank - start_rank, threads);
+}
+
+/*
+ * call visit(key) for every key, on up to `threads` threads (the number of hardware threads if 0).
+ * like GetElementsByRange, the keys are split into runs of consecutive ranks, and each thread
+ * visits its run in ascending order. visit must be safe to call concurrently.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename Visitor>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::ForEachParallel(Visitor visit,
+                                                                        size_t threads) {
+  VisitRanksParallel(0, size_, threads,
+                     [&visit](size_t, const SkiplistNode* node, size_t count) {
+                       for (; count > 0; --count, node = node->GetNext(0)) {
+                         visit(node->key_);
+                       }
+                     });
+}
+
+/*
+ * split the `count` keys ranked from `start` into runs of consecutive ranks, one per thread, and
+ * call visit(i, node, n) on the i-th thread with the first node of its run and the run's length.
+ * since any rank is found in O(log n) through span_, every thread finds its first node on its
+ * own instead of walking from `start`.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename Visit>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::VisitRanksParallel(size_t start,
+                                                                           size_t count,
+                                                                           size_t threads,
+                                                                           Visit visit) {
+  size_t partitions = Partitions(count, threads);
+  RunParallel(partitions, [&](size_t i) {
+    EpochGuard guard(concurrent_reads_);
+    size_t first = start + count * i / partitions;
+    size_t last = start + count * (i + 1) / partitions;
+    if (first < last) visit(i, GetElement(first), last - first);
+  });
+}
+
+/* copy the `count` keys ranked from `start`, each thread copying a run into its own vector */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+std::vector<Key> Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsParallel(
+    size_t start, size_t count, size_t threads) {
+  std::vector<std::vector<Key>> runs(Partitions(count, threads));
+  VisitRanksParallel(start, count, runs.size(),
+                     [&runs](size_t i, const SkiplistNode* node, size_t n) {
+                       runs[i].reserve(n);
+                       for (; n > 0; --n, node = node->GetNext(0)) {
+                         runs[i].push_back(node->key_);
+                       }
+                     });
+
+  std::vector<Key> keys = std::move(runs[0]);
+  keys.reserve(count);
+  for (size_t i = 1; i < runs.size(); ++i) {
+    std::move(runs[i].begin(), runs[i].end(), std::back_inserter(keys));
+  }
+  return keys;
+}
+
+/*
+ * return a view of the keys within the range [start, end), without copying them.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K1, typename K2, typename, typename>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::template View<false>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::Range(const K1& start, const K2& end) {
+  EpochGuard guard(concurrent_reads_);
+  size_t start_rank = 0, end_rank = 0;
+  const SkiplistNode* node = GetFirstElementGt(start, true, &start_rank);
+  GetFirstElementGt(end, true, &end_rank);
+  /* the range is empty if end is not greater than start */
+  if (end_rank <= start_rank) return View<false>(this, nullptr, 0);
+  return View<false>(this, node, end_rank - start_rank);
+}
+
+/* return the number of keys equal to the key, which is at most 1 without duplicates */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+size_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::Count(const K& key) {
+  EpochGuard guard(concurrent_reads_);
+  size_t start_rank = 0, end_rank = 0;
+  GetFirstElementGt(key, true, &start_rank);
+  GetFirstElementGt(key, false, &end_rank);
+  return end_rank - start_rank;
+}
+
+/* return a view of the keys equal to the key, in insertion order */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K, typename>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::template View<false>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::EqualRange(const K& key) {
+  EpochGuard guard(concurrent_reads_);
+  size_t start_rank = 0, end_rank = 0;
+  const SkiplistNode* node = GetFirstElementGt(key, true, &start_rank);
+  GetFirstElementGt(key, false, &end_rank);
+  if (end_rank == start_rank) return View<false>(this, nullptr, 0);
+  return View<false>(this, node, end_rank - start_rank);
+}
+
+/*
+ * return a view of the keys ranked within [start, end], without copying them.
+ * negative ranks count from the back like in GetElementsByRange.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::template View<false>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::RankRange(int start, int end) {
+  EpochGuard guard(concurrent_reads_);
+  ssize_t size = size_;
+  if (start < 0) start += size;
+  ssize_t last = std::min<ssize_t>(end < 0 ? end + size : end, size - 1);
+  if (start < 0 || start > last) return View<false>(this, nullptr, 0);
+
+  return View<false>(this, GetElement(start), last - start + 1);
+}
+
+/*
+ * return a view of the keys ranked within [start, end] from the back, without copying them.
+ * negative ranks count from the front like in GetElementsByRevRange.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::template View<true>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::RevRange(int start, int end) {
+  EpochGuard guard(concurrent_reads_);
+  ssize_t size = size_;
+  if (start < 0) start += size;
+  ssize_t last = std::min<ssize_t>(end < 0 ? end + size : end, size - 1);
+  if (start < 0 || start > last) return View<true>(this, nullptr, 0);
+
+  return View<true>(this, GetElement(size - 1 - start), last - start + 1);
+}
+
+/*
+ * call visit(key) for every key within the range [start, end) in order, without copying them.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K1, typename K2, typename Visitor, typename, typename>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::ForEachInRange(const K1& start,
+                                                                       const K2& end,
+                                                                       Visitor visit) {
+  EpochGuard guard(concurrent_reads_);
+  const SkiplistNode* node = GetFirstElementGt(start, true);
+  const uint64_t end_prefix = KeyPrefix(end);
+  while (node && Compare(node, end, end_prefix) < 0) {
+    visit(node->key_);
+    node = node->GetNext(0);
+  }
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+std::vector<Key>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsGt(const K& start, bool Eq) {
+  EpochGuard guard(concurrent_reads_);
   const SkiplistNode* ns = GetFirstElementGt(start, Eq);
 
   std::vector<Key> keys;
@@ -533,8 +2552,11 @@ std::vector<Key> Skiplist<Key, Comparator>::GetElementsGt(const Key& start, bool
   return keys;
 }
 
-template <typename Key, typename Comparator>
-std::vector<Key> Skiplist<Key, Comparator>::GetElementsLt(const Key& start, bool Eq) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+std::vector<Key>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsLt(const K& start, bool Eq) {
+  EpochGuard guard(concurrent_reads_);
   const SkiplistNode* ns = GetLastElementLt(start, Eq);
   if (ns == head_) return {};
 
@@ -548,34 +2570,61 @@ std::vector<Key> Skiplist<Key, Comparator>::GetElementsLt(const Key& start, bool
   return keys;
 }
 
-template <typename Key, typename Comparator>
-const typename Skiplist<Key, Comparator>::SkiplistNode*
-Skiplist<Key, Comparator>::GetFirstElementGt(const Key& key, bool Eq) {
-  const SkiplistNode* node = head_;
-  for (int i = level_ - 1; i >= 0; --i) {
-    while (node->GetNext(i) &&
-           (Eq ? Lt(node->GetNext(i)->key_, key) : Lte(node->GetNext(i)->key_, key))) {
-      node = node->GetNext(i);
+/*
+ * return the first node with a key greater than the key, or not less than it if `Eq` is set.
+ * if `rank` is given, the number of nodes before the returned node is added to it.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+const typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode*
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetFirstElementGt(const K& key, bool Eq,
+                                                                     size_t* rank) const {
+  const uint64_t prefix = KeyPrefix(key);
+  int top;
+  size_t start_rank;
+  const SkiplistNode* node = SearchStart(prefix, &top, &start_rank);
+  if (rank) *rank += start_rank;
+  /* the first node known to be past the key, which needs no comparison again */
+  const SkiplistNode* bound = nullptr;
+  for (int i = top; i >= 0; --i) {
+    const SkiplistNode* next = node->GetNext(i);
+    while (next && next != bound) {
+      int cmp = Compare(next, key, prefix);
+      if (Eq ? cmp >= 0 : cmp > 0) break;
+      if (rank) *rank += node->GetSpan(i);
+      node = next;
+      next = node->GetNext(i);
     }
+    bound = next;
   }
   return node->GetNext(0);
 }
 
-template <typename Key, typename Comparator>
-const typename Skiplist<Key, Comparator>::SkiplistNode* Skiplist<Key, Comparator>::GetLastElementLt(
-    const Key& key, bool Eq) {
-  const SkiplistNode* node = head_;
-  for (int i = level_ - 1; i >= 0; --i) {
-    while (node->GetNext(i) &&
-           (Eq ? Lte(node->GetNext(i)->key_, key) : Lt(node->GetNext(i)->key_, key))) {
-      node = node->GetNext(i);
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename K>
+const typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode*
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetLastElementLt(const K& key, bool Eq) const {
+  const uint64_t prefix = KeyPrefix(key);
+  int top;
+  size_t rank;
+  const SkiplistNode* node = SearchStart(prefix, &top, &rank);
+  /* the first node known to be past the key, which needs no comparison again */
+  const SkiplistNode* bound = nullptr;
+  for (int i = top; i >= 0; --i) {
+    const SkiplistNode* next = node->GetNext(i);
+    while (next && next != bound) {
+      int cmp = Compare(next, key, prefix);
+      if (Eq ? cmp > 0 : cmp >= 0) break;
+      node = next;
+      next = node->GetNext(i);
     }
+    bound = next;
   }
   return node;
 }
 
-template <typename Key, typename Comparator>
-const Key& Skiplist<Key, Comparator>::operator[](size_t i) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+const Key& Skiplist<Key, Comparator, Allocator, LevelPolicy>::operator[](size_t i) {
   const SkiplistNode* node = GetElement(i);
 
   if (node == nullptr) throw std::out_of_range("skiplist index out of bound");
@@ -583,14 +2632,14 @@ const Key& Skiplist<Key, Comparator>::operator[](size_t i) {
   return node->key_;
 }
 
-template <typename Key, typename Comparator>
-void Skiplist<Key, Comparator>::Clear() {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::Clear() {
   Reset();
-  level_ = InitSkiplistLevel;
+  level_.store(InitSkiplistLevel, std::memory_order_relaxed);
 }
 
-template <typename Key, typename Comparator>
-void Skiplist<Key, Comparator>::Print() const {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::Print() const {
   const SkiplistNode* node = head_;
   for (int i = level_ - 1; i >= 0; --i) {
     printf("h%d", i);
@@ -608,16 +2657,74 @@ void Skiplist<Key, Comparator>::Print() const {
  * the function assumes that the node exists in the skiplist.
  * should make sure the node contained in the skiplist before calling this function.
  */
-template <typename Key, typename Comparator>
-void Skiplist<Key, Comparator>::DeleteNode(const Key& key, SkiplistNode* update[MaxSkiplistLevel]) {
-  SkiplistNode* node_to_delete = update[0]->GetNext(0);
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::DeleteNode(
+    SkiplistNode* node, SkiplistNode* update[MaxSkiplistLevel]) {
+  UnlinkNode(node, update);
+  DropNode(node);
+}
+
+/*
+ * free an unlinked node, or retire it if concurrent readers may still be reading it.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::DropNode(SkiplistNode* node) {
+  if (concurrent_reads_) {
+    RetireNode(node, 1);
+  } else {
+    SkiplistNode::DestroySkiplistNode(allocator_, node);
+  }
+}
+
+/*
+ * defer freeing the `count` nodes starting at the node in level 0 until no reader can still be
+ * reading them.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::RetireNode(SkiplistNode* node,
+                                                                   size_t count) {
+  retired_.push_back({node, Epoch::Current(), count});
+  if (retired_.size() >= ReclaimThreshold) {
+    ReclaimNodes(false);
+  }
+}
+
+/*
+ * free the retired nodes no reader can still be reading, or all of them if `all` is set.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::ReclaimNodes(bool all) {
+  if (!all) Epoch::TryAdvance();
+
+  size_t kept = 0;
+  for (size_t i = 0; i < retired_.size(); ++i) {
+    if (!all && !Epoch::Expired(retired_[i].epoch_)) {
+      retired_[kept++] = retired_[i];
+      continue;
+    }
+    SkiplistNode* node = retired_[i].node_;
+    for (size_t n = retired_[i].count_; n > 0; --n) {
+      SkiplistNode* next = node->GetNext(0);
+      SkiplistNode::DestroySkiplistNode(allocator_, node);
+      node = next;
+    }
+  }
+  retired_.resize(kept);
+}
 
+/*
+ * unlink the node from every level and update span_.
+ * update[i] must be the last node before the node in level i.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::UnlinkNode(
+    SkiplistNode* node, SkiplistNode* update[MaxSkiplistLevel]) {
+  DropSearchIndex();
   for (int i = level_ - 1; i >= 0; --i) {
-    const SkiplistNode* next = update[i]->GetNext(i);
-    if (update[i] && next && Eq(next->key_, key)) {
-      update[i]->SetNext(i, next ? next->GetNext(i) : nullptr);
-      update[i]->SetSpan(i, update[i]->GetSpan(i) + (next ? next->GetSpan(i) : 0) - 1);
-    } else if (update[i]) {
+    if (update[i]->GetNext(i) == node) {
+      update[i]->SetNext(i, node->GetNext(i));
+      update[i]->SetSpan(i, update[i]->GetSpan(i) + node->GetSpan(i) - 1);
+    } else {
       update[i]->SetSpan(i, update[i]->GetSpan(i) - 1);
     }
   }
@@ -625,36 +2732,106 @@ void Skiplist<Key, Comparator>::DeleteNode(const Key& key, SkiplistNode* update[
   /* for level 0, update backward pointer since it's a double linked list */
   if (update[0]->GetNext(0)) {
     update[0]->GetNext(0)->SetPrev(update[0]);
+  } else {
+    tail_.store(update[0], std::memory_order_release);
+  }
+  size_.store(size_ - 1, std::memory_order_relaxed);
+}
+
+/*
+ * delete the `count` nodes following the first `start` nodes and return `count`.
+ * the last node before the run is searched once by rank. in each level, the run is then skipped
+ * by linking that node to the first node after the run, whose span is reduced by `count` at once.
+ * the run is only walked through in the levels it reaches, so the cost is O(log n + count)
+ * instead of a search per node. the unlinked nodes stay chained in level 0 and are freed, or
+ * retired as a single entry, together.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+size_t Skiplist<Key, Comparator, Allocator, LevelPolicy>::DeleteRun(size_t start, size_t count) {
+  SkiplistNode* update[MaxSkiplistLevel];
+  size_t rank[MaxSkiplistLevel];
+  SkiplistNode* node = head_;
+  size_t position = 0;
+  for (int i = level_ - 1; i >= 0; --i) {
+    while (node->GetNext(i) && position + node->GetSpan(i) <= start) {
+      position += node->GetSpan(i);
+      node = node->GetNext(i);
+    }
+    update[i] = node;
+    rank[i] = position;
+  }
+
+  DropSearchIndex();
+  SkiplistNode* first = update[0]->GetNext(0);
+  const size_t end = start + count;
+  /* unlink from the top, like UnlinkNode, so that readers never reach the run from above */
+  for (int i = level_ - 1; i >= 0; --i) {
+    /* the last node of the run in level i, if any */
+    SkiplistNode* last = update[i];
+    size_t last_rank = rank[i];
+    while (last->GetNext(i) && last_rank + last->GetSpan(i) <= end) {
+      last_rank += last->GetSpan(i);
+      last = last->GetNext(i);
+    }
+    size_t span = last_rank + last->GetSpan(i) - rank[i] - count;
+    if (last != update[i]) update[i]->SetNext(i, last->GetNext(i));
+    update[i]->SetSpan(i, span);
+  }
+
+  if (update[0]->GetNext(0)) {
+    update[0]->GetNext(0)->SetPrev(update[0]);
+  } else {
+    tail_.store(update[0], std::memory_order_release);
   }
+  size_.store(size_ - count, std::memory_order_relaxed);
 
-  delete node_to_delete;
-  --size_;
+  if (concurrent_reads_) {
+    RetireNode(first, count);
+  } else {
+    for (size_t n = count; n > 0; --n) {
+      SkiplistNode* next = first->GetNext(0);
+      SkiplistNode::DestroySkiplistNode(allocator_, first);
+      first = next;
+    }
+  }
+  return count;
 }
 
-template <typename Key, typename Comparator>
-const typename Skiplist<Key, Comparator>::SkiplistNode* Skiplist<Key, Comparator>::GetElement(
-    size_t rank) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+const typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode*
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElement(size_t rank) {
+  EpochGuard guard(concurrent_reads_);
   if (rank >= size_) return nullptr;
+  if (rank + 1 == size_) {
+    /* the last node is cached, which makes reverse ranges start in O(1) */
+    const SkiplistNode* tail = FindLast();
+    return tail != head_ ? tail : nullptr;
+  }
 
-  size_t span_ = 0;
-  const SkiplistNode* node = head_;
+  int top;
+  size_t span_;
+  const SkiplistNode* node = RankSearchStart(rank + 1, &top, &span_);
 
-  for (int i = level_ - 1; i >= 0; --i) {
-    while (node->GetNext(i) && (span_ + node->GetSpan(i) < rank + 1)) {
+  for (int i = top; i >= 0; --i) {
+    const SkiplistNode* next = node->GetNext(i);
+    while (next && (span_ + node->GetSpan(i) < rank + 1)) {
       span_ += node->GetSpan(i);
-      node = node->GetNext(i);
+      node = next;
+      next = node->GetNext(i);
     }
 
-    if (node->GetNext(i) && span_ + node->GetSpan(i) == rank + 1) {
-      return node->GetNext(i);
+    if (next && span_ + node->GetSpan(i) == rank + 1) {
+      return next;
     }
   }
 
   return nullptr;
 }
 
-template <typename Key, typename Comparator>
-std::vector<Key> Skiplist<Key, Comparator>::GetElements(size_t start, size_t end) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+std::vector<Key>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElements(size_t start, size_t end) {
+  EpochGuard guard(concurrent_reads_);
   if (start > end) return {};
 
   const SkiplistNode* node = GetElement(start);
@@ -669,8 +2846,10 @@ std::vector<Key> Skiplist<Key, Comparator>::GetElements(size_t start, size_t end
   return keys;
 }
 
-template <typename Key, typename Comparator>
-std::vector<Key> Skiplist<Key, Comparator>::GetElementsRev(size_t start, size_t end) {
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+std::vector<Key>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::GetElementsRev(size_t start, size_t end) {
+  EpochGuard guard(concurrent_reads_);
   if (start > end) return {};
 
   const SkiplistNode* node = GetElement(size_ - 1 - start);
@@ -685,36 +2864,240 @@ std::vector<Key> Skiplist<Key, Comparator>::GetElementsRev(size_t start, size_t
   return keys;
 }
 
-template <typename Key, typename Comparator>
-const typename Skiplist<Key, Comparator>::SkiplistNode* Skiplist<Key, Comparator>::FindLast()
-    const {
-  const SkiplistNode* node = head_;
+/* return the last node, or the head if the skiplist is empty */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+const typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode*
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::FindLast() const {
+  return tail_.load(std::memory_order_acquire);
+}
+
+/*
+ * return the node to start a search for a key with the given prefix from, the level to start at
+ * and the node's rank. with a search index, the last indexed node with a smaller prefix has a
+ * smaller key, and the next indexed node is never before the key unless their prefixes tie, so
+ * the search starts below the indexed level. otherwise it starts from the head at the top.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+const typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode*
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::SearchStart(uint64_t prefix, int* level,
+                                                               size_t* rank) const {
+  const SearchIndex* index = CachePrefix ? index_.load(std::memory_order_acquire) : nullptr;
+  *rank = 0;
+  if (!index) {
+    *level = level_ - 1;
+    return head_;
+  }
+
+  *level = IndexedLevel - 1;
+  ssize_t i = index->prefixes_.FindLastLess(prefix);
+  if (i < 0) return head_;
+  *rank = index->ranks_.Get(i);
+  return index->nodes_[i];
+}
+
+/* like SearchStart, for the node at the 1-based `position` */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+const typename Skiplist<Key, Comparator, Allocator, LevelPolicy>::SkiplistNode*
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::RankSearchStart(size_t position, int* level,
+                                                                   size_t* rank) const {
+  const SearchIndex* index = CachePrefix ? index_.load(std::memory_order_acquire) : nullptr;
+  *rank = 0;
+  if (!index) {
+    *level = level_ - 1;
+    return head_;
+  }
+
+  *level = IndexedLevel - 1;
+  ssize_t i = index->ranks_.FindLastLess(position);
+  if (i < 0) return head_;
+  *rank = index->ranks_.Get(i);
+  return index->nodes_[i];
+}
+
+/*
+ * search the keys in [first, last) in groups of SearchGroupSize, and call visit(i, rank) with the
+ * position of each key and its rank, or -1 if it does not exist.
+ * the searches of a group take one step each in turn, where a step compares the key with the next
+ * node or moves down a level, and prefetches the node to compare with in the following step. by
+ * the time a search takes its next step, the node has most likely arrived in the cache.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+template <typename ForwardIt, typename Visit>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::SearchMany(ForwardIt first, ForwardIt last,
+                                                                   Visit visit) const {
+  struct Search {
+    ForwardIt key;
+    uint64_t prefix;
+    const SkiplistNode* node;
+    const SkiplistNode* next;
+    /* the first node known to be greater than the key, which needs no comparison again */
+    const SkiplistNode* bound;
+    int level;
+    size_t rank;
+    bool found;
+  };
+  Search searches[SearchGroupSize];
+
+  size_t offset = 0;
+  while (first != last) {
+    size_t active = 0;
+    for (; first != last && active < SearchGroupSize; ++first, ++active) {
+      Search& search = searches[active];
+      search.key = first;
+      search.prefix = KeyPrefix(*first);
+      search.node = SearchStart(search.prefix, &search.level, &search.rank);
+      search.next = search.node->GetNext(search.level);
+      search.bound = nullptr;
+      search.found = false;
+      Prefetch(search.next);
+    }
 
-  int l = level_;
-  while (--l >= 0) {
-    while (node->GetNext(l)) {
-      node = node->GetNext(l);
+    /* searches are numbered by their position in the group, active ones first */
+    size_t index[SearchGroupSize];
+    for (size_t i = 0; i < active; ++i) {
+      index[i] = i;
     }
+    while (active > 0) {
+      for (size_t i = 0; i < active;) {
+        Search& search = searches[index[i]];
+        if (search.next && search.next != search.bound) {
+          int cmp = Compare(search.next, *search.key, search.prefix);
+          if (cmp < 0) {
+            search.rank += search.node->GetSpan(search.level);
+            search.node = search.next;
+            search.next = search.node->GetNext(search.level);
+            Prefetch(search.next);
+            ++i;
+            continue;
+          }
+          if (cmp == 0 && !duplicates_) {
+            visit(offset + index[i], search.rank + search.node->GetSpan(search.level) - 1);
+            index[i] = index[--active];
+            continue;
+          }
+          /* with duplicates, go on to the first equal key like in GetRankofElement */
+          search.found = search.found || cmp == 0;
+        }
+        if (search.level == 0) {
+          visit(offset + index[i], search.found ? static_cast<ssize_t>(search.rank) : -1);
+          index[i] = index[--active];
+          continue;
+        }
+        search.bound = search.next;
+        search.next = search.node->GetNext(--search.level);
+        Prefetch(search.next);
+        ++i;
+      }
+    }
+    offset += SearchGroupSize;
   }
+}
 
-  return node;
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::Prefetch(const void* p) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(p);
+#else
+  (void)p;
+#endif
 }
 
-template <typename Key, typename Comparator>
-void Skiplist<Key, Comparator>::Reset() {
-  SkiplistNode* node = head_->GetNext(0);
-  while (node) {
-    SkiplistNode* next = node->GetNext(0);
-    delete node;
-    node = next;
+/* readers may still be searching the index, so it is retired like a node */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::DropSearchIndex() {
+  SearchIndex* index = index_.load(std::memory_order_relaxed);
+  if (!index) return;
+
+  index_.store(nullptr, std::memory_order_release);
+  if (concurrent_reads_) {
+    Epoch::Retire(index, [](void* p) { delete static_cast<SearchIndex*>(p); });
+  } else {
+    delete index;
   }
-  head_->Reset();
-  size_ = 0;
 }
 
-template <typename Key, typename Comparator>
-Skiplist<Key, Comparator>::~Skiplist() {
-  Reset();
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::MoveFrom(Skiplist& skiplist) {
+  skiplist.DropSearchIndex();
+  allocator_ = std::move(skiplist.allocator_);
+  head_ = skiplist.head_;
+  tail_.store(skiplist.tail_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  level_.store(skiplist.level_, std::memory_order_relaxed);
+  size_.store(skiplist.size_, std::memory_order_relaxed);
+  concurrent_reads_ = skiplist.concurrent_reads_;
+  duplicates_.store(skiplist.duplicates_, std::memory_order_relaxed);
+  retired_ = std::move(skiplist.retired_);
+
+  skiplist.head_ = SkiplistNode::CreateSkiplistNode(skiplist.allocator_, MaxSkiplistLevel);
+  skiplist.tail_.store(skiplist.head_, std::memory_order_relaxed);
+  skiplist.level_.store(InitSkiplistLevel, std::memory_order_relaxed);
+  skiplist.size_.store(0, std::memory_order_relaxed);
+  skiplist.retired_.clear();
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::AssignComparator(const Comparator& compare,
+                                                                         std::true_type) {
+  compare_ = compare;
+}
+
+/* closures are not assignable before C++20, so the comparator is constructed again in place */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::AssignComparator(const Comparator& compare,
+                                                                         std::false_type) {
+  using Compare = typename std::remove_const<Comparator>::type;
+  compare_.~Compare();
+  new (&compare_) Compare(compare);
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::Reset() {
+  DropSearchIndex();
+  if (concurrent_reads_) {
+    /* readers may still be traversing the nodes, detach them from the head and retire them */
+    SkiplistNode* node = head_->GetNext(0);
+    head_->Reset(MaxSkiplistLevel);
+    if (node) RetireNode(node, size_);
+  } else {
+    FreeNodes();
+    head_ = SkiplistNode::CreateSkiplistNode(allocator_, MaxSkiplistLevel);
+  }
+  tail_.store(head_, std::memory_order_release);
+  size_.store(0, std::memory_order_relaxed);
+}
+
+/*
+ * free every node including the head.
+ * if the allocator can release all of its memory at once, only the keys need to be destroyed
+ * (nothing at all for trivially destructible keys) before handing the chunks back.
+ */
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+void Skiplist<Key, Comparator, Allocator, LevelPolicy>::FreeNodes() {
+  SkiplistNode* node = head_;
+  if (Allocator::SupportsRelease) {
+    if (!std::is_trivially_destructible<Key>::value) {
+      while (node) {
+        SkiplistNode* next = node->GetNext(0);
+        node->~SkiplistNode();
+        node = next;
+      }
+    }
+    allocator_.Release();
+  } else {
+    while (node) {
+      SkiplistNode* next = node->GetNext(0);
+      SkiplistNode::DestroySkiplistNode(allocator_, node);
+      node = next;
+    }
+  }
+  head_ = nullptr;
+}
+
+template <typename Key, typename Comparator, typename Allocator, typename LevelPolicy>
+Skiplist<Key, Comparator, Allocator, LevelPolicy>::~Skiplist() {
+  delete index_.load(std::memory_order_relaxed);
+  ReclaimNodes(true);
+  FreeNodes();
 }
 
 }  // namespace skiplist
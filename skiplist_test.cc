@@ -2,7 +2,11 @@
 
 #include <gtest/gtest.h>
 
+#include <climits>
+#include <random>
+#include <set>
 #include <string>
+#include <thread>
 
 namespace skiplist {
 class SkiplistTest : public testing::Test {
@@ -321,6 +325,38 @@ TEST_F(SkiplistTest, GetElementsInRange) {
   ASSERT_EQ(k9.size(), 0);
 }
 
+TEST_F(SkiplistTest, Views) {
+  std::vector<std::string> keys;
+  for (const std::string& key : skiplist->Range("key1", "key5")) {
+    keys.push_back(key);
+  }
+  ASSERT_EQ(keys, std::vector<std::string>({"key2", "key4"}));
+  ASSERT_EQ(skiplist->Range("key0", "key9").Size(), 4);
+  ASSERT_TRUE(skiplist->Range("key5", "key1").Empty());
+  ASSERT_TRUE(skiplist->Range("key6", "key9").Empty());
+
+  keys.clear();
+  for (const std::string& key : skiplist->RankRange(1, -1)) {
+    keys.push_back(key);
+  }
+  ASSERT_EQ(keys, std::vector<std::string>({"key2", "key4", "key5"}));
+  ASSERT_EQ(skiplist->RankRange(-2, 10).Size(), 2);
+  ASSERT_TRUE(skiplist->RankRange(4, 10).Empty());
+  ASSERT_TRUE(skiplist->RankRange(2, 1).Empty());
+
+  keys.clear();
+  for (const std::string& key : skiplist->RevRange(0, 2)) {
+    keys.push_back(key);
+  }
+  ASSERT_EQ(keys, std::vector<std::string>({"key5", "key4", "key2"}));
+  ASSERT_EQ(skiplist->RevRange(-1, -1).Size(), 1);
+  ASSERT_EQ(*skiplist->RevRange(-1, -1).begin(), "key0");
+
+  keys.clear();
+  skiplist->ForEachInRange("key2", "key5", [&keys](const std::string& key) { keys.push_back(key); });
+  ASSERT_EQ(keys, std::vector<std::string>({"key2", "key4"}));
+}
+
 TEST_F(SkiplistTest, ArrayAccess) {
   ASSERT_EQ((*skiplist)[0], "key0");
   ASSERT_EQ((*skiplist)[1], "key2");
@@ -354,6 +390,43 @@ TEST_F(SkiplistTest, Iteration) {
   ScanSkiplist(skiplist);
 }
 
+TEST_F(SkiplistTest, StandardIteration) {
+  using Iterator = Skiplist<std::string>::Iterator;
+  static_assert(std::is_same<std::iterator_traits<Iterator>::iterator_category,
+                             std::bidirectional_iterator_tag>::value,
+                "skiplist iterators must be bidirectional");
+
+  const Skiplist<std::string>& list = *skiplist;
+  ASSERT_EQ(std::distance(list.begin(), list.end()), 4);
+  ASSERT_EQ(std::vector<std::string>(list.rbegin(), list.rend()),
+            std::vector<std::string>({"key5", "key4", "key2", "key0"}));
+  ASSERT_EQ(*std::prev(list.End()), "key5");
+  ASSERT_EQ(std::find(list.Begin(), list.End(), "key4")->size(), 4);
+
+  std::vector<std::string> keys;
+  for (const std::string& key : list) {
+    keys.push_back(key);
+  }
+  ASSERT_EQ(keys, std::vector<std::string>({"key0", "key2", "key4", "key5"}));
+
+  Iterator it = list.Begin();
+  ASSERT_EQ(*it++, "key0");
+  ASSERT_EQ(*it, "key2");
+  ASSERT_EQ(*it--, "key2");
+  ASSERT_EQ(*it, "key0");
+
+  ASSERT_EQ(*list.LowerBound("key2"), "key2");
+  ASSERT_EQ(*list.UpperBound("key2"), "key4");
+  ASSERT_EQ(*list.LowerBound("key3"), "key4");
+  ASSERT_TRUE(list.LowerBound("key6") == list.End());
+  ASSERT_TRUE(list.UpperBound("key5") == list.End());
+
+  it.Seek("key1");
+  ASSERT_EQ(*it, "key2");
+  it.Seek("key9");
+  ASSERT_TRUE(it == list.End());
+}
+
 void ScanSkiplist(const Skiplist<std::string>* skiplist) {
   printf("----start scanning skiplist----\n");
   for (auto it = skiplist->Begin(); it != skiplist->End(); ++it) {
@@ -416,4 +489,968 @@ TEST_F(CustomSkiplistTest, GetElementsInRange) {
   ASSERT_EQ(ks[0], "key2");
   ASSERT_EQ(ks[1], "key1");
 }
+
+TEST(SkiplistNodeTest, ManyLevels) {
+  Skiplist<int> skiplist(1);
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(skiplist.Insert(i * 2));
+  }
+  for (int i = 0; i < 1000; i += 3) {
+    ASSERT_TRUE(skiplist.Delete(i * 2));
+  }
+  ASSERT_EQ(skiplist.Size(), 666);
+
+  int rank = 0;
+  for (int i = 0; i < 1000; ++i) {
+    if (i % 3 == 0) {
+      ASSERT_FALSE(skiplist.Contains(i * 2));
+      continue;
+    }
+    ASSERT_EQ(skiplist.GetRankofElement(i * 2), rank);
+    ASSERT_EQ(skiplist[rank], i * 2);
+    ++rank;
+  }
+}
+
+TEST(SkiplistNodeTest, UpdateExistingKey) {
+  Skiplist<int> skiplist(4);
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(skiplist.Insert(i));
+  }
+
+  /* the node is moved and the ranks are kept consistent */
+  ASSERT_TRUE(skiplist.Update(2, 20));
+  ASSERT_EQ(skiplist.GetRankofElement(20), 9);
+  ASSERT_EQ(skiplist.GetRankofElement(3), 2);
+
+  /* updating to an existing key removes the original one */
+  ASSERT_FALSE(skiplist.Update(4, 5));
+  ASSERT_FALSE(skiplist.Contains(4));
+  ASSERT_EQ(skiplist.Size(), 9);
+  ASSERT_EQ(skiplist.GetRankofElement(5), 3);
+}
+
+TEST(SkiplistEndsTest, FrontBackAndPop) {
+  Skiplist<int> skiplist;
+  ASSERT_THROW(skiplist.Front(), std::out_of_range);
+  ASSERT_THROW(skiplist.Back(), std::out_of_range);
+  ASSERT_FALSE(skiplist.PopFront());
+  ASSERT_FALSE(skiplist.PopBack());
+
+  for (int i = 0; i < 100; ++i) {
+    skiplist.Insert(i);
+  }
+  ASSERT_EQ(skiplist.Front(), 0);
+  ASSERT_EQ(skiplist.Back(), 99);
+
+  /* the tail follows updates and deletions */
+  ASSERT_TRUE(skiplist.Update(99, 150));
+  ASSERT_EQ(skiplist.Back(), 150);
+  ASSERT_FALSE(skiplist.Update(150, 50));
+  ASSERT_FALSE(skiplist.Contains(150));
+  ASSERT_EQ(skiplist.Back(), 98);
+  ASSERT_TRUE(skiplist.Delete(98));
+  ASSERT_EQ(skiplist.Back(), 97);
+  ASSERT_EQ(*std::prev(skiplist.End()), 97);
+  ASSERT_EQ(skiplist.GetElementByRank(-1), 97);
+
+  int key;
+  ASSERT_TRUE(skiplist.PopFront(&key));
+  ASSERT_EQ(key, 0);
+  ASSERT_TRUE(skiplist.PopBack(&key));
+  ASSERT_EQ(key, 97);
+  ASSERT_EQ(skiplist.Size(), 96);
+  ASSERT_EQ(skiplist.Front(), 1);
+  ASSERT_EQ(skiplist.Back(), 96);
+  for (int i = 1; i <= 96; ++i) {
+    ASSERT_EQ(skiplist.GetRankofElement(i), i - 1);
+  }
+
+  while (skiplist.PopBack()) {
+  }
+  ASSERT_EQ(skiplist.Size(), 0);
+  ASSERT_TRUE(skiplist.Begin() == skiplist.End());
+  skiplist.Insert(5);
+  ASSERT_EQ(skiplist.Back(), 5);
+
+  std::vector<int> keys = {1, 2, 3};
+  skiplist.BulkLoad(keys.begin(), keys.end());
+  ASSERT_EQ(skiplist.Back(), 3);
+  skiplist.Clear();
+  ASSERT_THROW(skiplist.Back(), std::out_of_range);
+}
+
+TEST(BulkLoadTest, SortedInput) {
+  for (bool balanced : {false, true}) {
+    Skiplist<int> skiplist;
+    std::vector<int> keys;
+    for (int i = 0; i < 1000; ++i) {
+      keys.push_back(i * 2);
+      if (i % 10 == 0) keys.push_back(i * 2);
+    }
+    skiplist.BulkLoad(keys.begin(), keys.end(), balanced);
+    ASSERT_EQ(skiplist.Size(), 1000);
+
+    for (int i = 0; i < 1000; ++i) {
+      ASSERT_TRUE(skiplist.Contains(i * 2));
+      ASSERT_FALSE(skiplist.Contains(i * 2 + 1));
+      ASSERT_EQ(skiplist.GetRankofElement(i * 2), i);
+      ASSERT_EQ(skiplist.GetElementByRank(i), i * 2);
+    }
+    ASSERT_EQ(skiplist.GetElementsByRevRange(0, 1), std::vector<int>({1998, 1996}));
+
+    /* spans must stay consistent for later updates */
+    ASSERT_TRUE(skiplist.Insert(1));
+    ASSERT_TRUE(skiplist.Delete(100));
+    ASSERT_TRUE(skiplist.Insert(5000));
+    ASSERT_EQ(skiplist.GetRankofElement(1), 1);
+    ASSERT_EQ(skiplist.GetRankofElement(102), 51);
+    ASSERT_EQ(skiplist.GetElementByRank(-1), 5000);
+    ASSERT_EQ(skiplist.Size(), 1001);
+  }
+}
+
+TEST(BulkLoadTest, UnsortedInput) {
+  Skiplist<int> skiplist;
+  skiplist.Insert(1);
+  std::vector<int> keys = {1, 2, 4, 3};
+  ASSERT_THROW(skiplist.BulkLoad(keys.begin(), keys.end()), std::invalid_argument);
+  ASSERT_EQ(skiplist.Size(), 0);
+  ASSERT_FALSE(skiplist.Contains(1));
+
+  skiplist.BulkLoad(keys.begin(), keys.begin());
+  ASSERT_EQ(skiplist.Size(), 0);
+  ASSERT_TRUE(skiplist.Insert(3));
+  ASSERT_EQ(skiplist.GetRankofElement(3), 0);
+}
+
+TEST(BatchTest, InsertContainsDelete) {
+  Skiplist<int> skiplist;
+  std::set<int> expected;
+  for (int i = 0; i < 100; ++i) {
+    skiplist.Insert(i * 10);
+    expected.insert(i * 10);
+  }
+
+  std::vector<int> keys;
+  for (int i = 0; i < 2000; i += 3) {
+    keys.push_back(i);
+  }
+  keys.push_back(2100);
+  keys.push_back(2100);
+  size_t inserted = 0;
+  for (int key : keys) {
+    inserted += expected.insert(key).second;
+  }
+  ASSERT_EQ(skiplist.InsertBatch(keys.begin(), keys.end()), inserted);
+  ASSERT_EQ(skiplist.Size(), expected.size());
+
+  int rank = 0;
+  for (int key : expected) {
+    ASSERT_EQ(skiplist.GetRankofElement(key), rank);
+    ASSERT_EQ(skiplist.GetElementByRank(rank), key);
+    ++rank;
+  }
+
+  /* out of order keys fall back to a search from the head */
+  std::vector<int> lookups = {0, 1, 3, 2100, 5, 9, 2101};
+  ASSERT_EQ(skiplist.ContainsBatch(lookups.begin(), lookups.end()),
+            std::vector<bool>({true, false, true, true, false, true, false}));
+
+  std::vector<int> deletions = {3, 10, 10, 11, 1500, 2100, 0, 2200};
+  size_t deleted = 0;
+  for (int key : deletions) {
+    deleted += expected.erase(key);
+  }
+  ASSERT_EQ(skiplist.DeleteBatch(deletions.begin(), deletions.end()), deleted);
+  ASSERT_EQ(skiplist.Size(), expected.size());
+
+  rank = 0;
+  for (int key : expected) {
+    ASSERT_EQ(skiplist.GetRankofElement(key), rank);
+    ++rank;
+  }
+  ASSERT_EQ(std::vector<int>(expected.begin(), expected.end()),
+            skiplist.GetElementsByRange(0, -1));
+}
+
+TEST(BatchTest, ContainsAndRankMany) {
+  Skiplist<int> skiplist;
+  std::vector<int> sorted;
+  for (int i = 0; i < 5000; ++i) {
+    skiplist.Insert(i * 2);
+    sorted.push_back(i * 2);
+  }
+  std::vector<int> empty;
+  ASSERT_TRUE(skiplist.ContainsMany(empty.begin(), empty.end()).empty());
+
+  /* unsorted keys, spanning several groups, missing ones mixed in */
+  std::mt19937 rng(17);
+  std::vector<int> keys;
+  for (int i = 0; i < 1000; ++i) {
+    keys.push_back(static_cast<int>(rng() % 10002) - 1);
+  }
+  std::vector<bool> exist = skiplist.ContainsMany(keys.begin(), keys.end());
+  std::vector<ssize_t> ranks = skiplist.RankMany(keys.begin(), keys.end());
+  ASSERT_EQ(exist.size(), keys.size());
+  ASSERT_EQ(ranks.size(), keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_EQ(exist[i], skiplist.Contains(keys[i]));
+    ASSERT_EQ(ranks[i], skiplist.GetRankofElement(keys[i]));
+  }
+
+  /* searches also start from the search index */
+  Skiplist<int, IntegerCompare<int>> indexed(4, IntegerCompare<int>());
+  indexed.BulkLoad(sorted.begin(), sorted.end());
+  indexed.BuildSearchIndex();
+  ASSERT_EQ(indexed.RankMany(keys.begin(), keys.end()), ranks);
+}
+
+/* a key counting how many times keys are copied */
+struct CountedKey {
+  static int copies;
+  CountedKey(int v = 0) : v(v) {}
+  CountedKey(int v, int scale) : v(v * scale) {}
+  CountedKey(const CountedKey& key) : v(key.v) { ++copies; }
+  CountedKey(CountedKey&& key) : v(key.v) {}
+  CountedKey& operator=(const CountedKey& key) {
+    v = key.v;
+    ++copies;
+    return *this;
+  }
+  CountedKey& operator=(CountedKey&& key) {
+    v = key.v;
+    return *this;
+  }
+  bool operator<(const CountedKey& key) const { return v < key.v; }
+  bool operator==(const CountedKey& key) const { return v == key.v; }
+  int v;
+};
+int CountedKey::copies = 0;
+
+TEST(MoveTest, InsertEmplaceAndUpdate) {
+  Skiplist<CountedKey> skiplist;
+  CountedKey::copies = 0;
+  for (int i = 0; i < 100; ++i) {
+    CountedKey key(i * 2);
+    ASSERT_TRUE(skiplist.Insert(std::move(key)));
+    ASSERT_TRUE(skiplist.Emplace(i * 2 + 1));
+  }
+  ASSERT_FALSE(skiplist.Emplace(10, 2));
+  ASSERT_TRUE(skiplist.Emplace(100, 3));
+  ASSERT_TRUE(skiplist.Update(CountedKey(300), CountedKey(1000)));
+  ASSERT_FALSE(skiplist.Update(CountedKey(300), CountedKey(1001)));
+  ASSERT_EQ(CountedKey::copies, 0);
+
+  ASSERT_EQ(skiplist.Size(), 201);
+  for (int i = 0; i < 200; ++i) {
+    ASSERT_EQ(skiplist.GetElementByRank(i).v, i);
+  }
+  ASSERT_EQ(skiplist.GetElementByRank(-1).v, 1000);
+
+  Skiplist<std::string> strings;
+  std::string key(100, 'a');
+  ASSERT_TRUE(strings.Insert(std::move(key)));
+  ASSERT_TRUE(key.empty());
+  /* a key which is not inserted is not moved from */
+  key.assign(100, 'a');
+  ASSERT_FALSE(strings.Insert(std::move(key)));
+  ASSERT_EQ(key, std::string(100, 'a'));
+  ASSERT_TRUE(strings.Emplace(50, 'b'));
+  ASSERT_EQ(strings.GetElementsByRange(0, -1),
+            std::vector<std::string>({std::string(100, 'a'), std::string(50, 'b')}));
+}
+
+template <typename List>
+void CheckMove() {
+  List skiplist;
+  for (int i = 0; i < 100; ++i) {
+    skiplist.Insert(std::to_string(i));
+  }
+
+  List moved(std::move(skiplist));
+  ASSERT_EQ(moved.Size(), 100);
+  ASSERT_EQ(moved.Back(), "99");
+  ASSERT_EQ(moved.GetRankofElement("50"), 46);
+  /* the moved-from skiplist is empty and usable */
+  ASSERT_EQ(skiplist.Size(), 0);
+  ASSERT_EQ(skiplist.Begin(), skiplist.End());
+  ASSERT_TRUE(skiplist.Insert("key"));
+  ASSERT_EQ(skiplist.Front(), "key");
+
+  skiplist = std::move(moved);
+  ASSERT_EQ(skiplist.Size(), 100);
+  ASSERT_EQ(skiplist.GetElementByRank(0), "0");
+  ASSERT_EQ(moved.Size(), 0);
+  skiplist = std::move(skiplist);
+  ASSERT_EQ(skiplist.Size(), 100);
+  ASSERT_TRUE(moved.Insert("key"));
+  ASSERT_EQ(std::distance(moved.Begin(), moved.End()), 1);
+}
+
+TEST(MoveTest, MoveSkiplist) {
+  CheckMove<Skiplist<std::string>>();
+  CheckMove<ArenaSkiplist<std::string>>();
+
+  /* retired nodes move along with the skiplist */
+  Skiplist<int> skiplist;
+  skiplist.EnableConcurrentReads();
+  for (int i = 0; i < 10; ++i) {
+    skiplist.Insert(i);
+  }
+  skiplist.Delete(5);
+  Skiplist<int> moved(std::move(skiplist));
+  ASSERT_FALSE(moved.Contains(5));
+  ASSERT_EQ(moved.Size(), 9);
+}
+
+/* a key that cannot be constructed from the id it is looked up with */
+struct Employee {
+  int id;
+  std::string name;
+};
+bool operator<(const Employee& e1, const Employee& e2) { return e1.id < e2.id; }
+bool operator==(const Employee& e1, const Employee& e2) { return e1.id == e2.id; }
+bool operator<(const Employee& e, int id) { return e.id < id; }
+bool operator==(const Employee& e, int id) { return e.id == id; }
+
+TEST(TransparentLookupTest, CStringLookup) {
+  Skiplist<std::string, TransparentCompare> skiplist(2, TransparentCompare());
+  for (int i = 0; i < 10; ++i) {
+    skiplist.Insert("key" + std::to_string(i));
+  }
+
+  ASSERT_TRUE(skiplist.Contains("key3"));
+  ASSERT_FALSE(skiplist.Contains("key33"));
+  ASSERT_EQ(skiplist.GetRankofElement("key5"), 5);
+  ASSERT_EQ(*skiplist.LowerBound("key55"), "key6");
+  ASSERT_EQ(*skiplist.UpperBound("key6"), "key7");
+  ASSERT_EQ(skiplist.GetElementsGt("key7"), std::vector<std::string>({"key8", "key9"}));
+  ASSERT_EQ(skiplist.GetElementsGte("key8"), std::vector<std::string>({"key8", "key9"}));
+  ASSERT_EQ(skiplist.GetElementsLt("key1"), std::vector<std::string>({"key0"}));
+  ASSERT_EQ(skiplist.GetElementsLte("key1"), std::vector<std::string>({"key0", "key1"}));
+  ASSERT_EQ(skiplist.GetElementsInRange("key2", "key4"),
+            std::vector<std::string>({"key2", "key3"}));
+  /* pointers to the literals are never compared with each other */
+  ASSERT_TRUE(skiplist.GetElementsInRange("key4", "key2").empty());
+
+  std::vector<std::string> keys;
+  for (const std::string& key : skiplist.Range("key4", "key7")) {
+    keys.push_back(key);
+  }
+  ASSERT_EQ(keys, std::vector<std::string>({"key4", "key5", "key6"}));
+  ASSERT_EQ(std::distance(skiplist.Range("key7", "key4").begin(),
+                          skiplist.Range("key7", "key4").end()),
+            0);
+  keys.clear();
+  skiplist.ForEachInRange("key8", "key99", [&keys](const std::string& key) {
+    keys.push_back(key);
+  });
+  ASSERT_EQ(keys, std::vector<std::string>({"key8", "key9"}));
+
+  ASSERT_TRUE(skiplist.Delete("key0"));
+  ASSERT_FALSE(skiplist.Delete("key0"));
+  ASSERT_EQ(skiplist.Size(), 9);
+  /* keys are still accepted */
+  ASSERT_TRUE(skiplist.Contains(std::string("key1")));
+
+#if __cplusplus >= 201703L
+  std::string_view view("key2 and more", 4);
+  ASSERT_TRUE(skiplist.Contains(view));
+  ASSERT_EQ(skiplist.GetRankofElement(view), 1);
+#endif
+}
+
+TEST(TransparentLookupTest, LookupById) {
+  Skiplist<Employee, TransparentCompare> skiplist(2, TransparentCompare());
+  for (int i = 0; i < 100; ++i) {
+    skiplist.Insert({i * 2, "employee" + std::to_string(i)});
+  }
+
+  ASSERT_TRUE(skiplist.Contains(42));
+  ASSERT_FALSE(skiplist.Contains(43));
+  ASSERT_EQ(skiplist.GetRankofElement(42), 21);
+  ASSERT_EQ(skiplist.LowerBound(43)->name, "employee22");
+  ASSERT_EQ(skiplist.GetElementsInRange(10, 16).size(), 3);
+  ASSERT_TRUE(skiplist.Delete(42));
+  ASSERT_FALSE(skiplist.Contains(42));
+}
+
+TEST(KeyPrefixTest, StringPrefix) {
+  StringPrefixCompare compare;
+  ASSERT_EQ(compare.Prefix(std::string("")), 0);
+  ASSERT_EQ(compare.Prefix(std::string("a")), 0x6100000000000000);
+  ASSERT_EQ(compare.Prefix(std::string("abcdefghij")), 0x6162636465666768);
+  ASSERT_EQ(compare.Prefix("abcdefghij"), compare.Prefix(std::string("abcdefgh")));
+  ASSERT_LT(compare.Prefix(std::string("ab")), compare.Prefix(std::string("abc")));
+  ASSERT_LT(compare.Prefix(std::string("a\x7f")), compare.Prefix(std::string("a\x80")));
+}
+
+TEST(KeyPrefixTest, MatchesSet) {
+  Skiplist<std::string, StringPrefixCompare> skiplist(2, StringPrefixCompare());
+  std::set<std::string> expected;
+  /* keys sharing their first 8 bytes are ordered by the comparator */
+  const char* prefixes[] = {"", "a", "key", "key0000", "key00000", "\x80\xff"};
+  std::mt19937 rng(7);
+  for (int i = 0; i < 2000; ++i) {
+    std::string key = prefixes[rng() % 6] + std::to_string(rng() % 500);
+    if (rng() % 8 == 0) key.push_back('\0');
+    ASSERT_EQ(skiplist.Insert(key), expected.insert(key).second);
+  }
+  for (int i = 0; i < 500; ++i) {
+    std::string key = prefixes[rng() % 6] + std::to_string(rng() % 500);
+    ASSERT_EQ(skiplist.Delete(key), expected.erase(key) > 0);
+  }
+
+  ASSERT_EQ(skiplist.GetElementsByRange(0, -1),
+            std::vector<std::string>(expected.begin(), expected.end()));
+  int rank = 0;
+  for (const std::string& key : expected) {
+    ASSERT_TRUE(skiplist.Contains(key));
+    ASSERT_EQ(skiplist.GetRankofElement(key), rank++);
+    std::string missing = key + "!";
+    ASSERT_EQ(skiplist.Contains(missing), expected.count(missing) > 0);
+    auto it = expected.lower_bound(missing);
+    auto found = skiplist.LowerBound(missing);
+    ASSERT_EQ(it == expected.end(), found == skiplist.End());
+    if (found != skiplist.End()) {
+      ASSERT_EQ(*found, *it);
+    }
+  }
+  ASSERT_EQ(skiplist.GetElementsInRange("key0000", "key00001"),
+            std::vector<std::string>(expected.lower_bound("key0000"),
+                                     expected.lower_bound("key00001")));
+
+  /* updated keys get their prefix updated */
+  std::string first = *expected.begin();
+  ASSERT_TRUE(skiplist.Update(first, "zzzzzzzzzz"));
+  ASSERT_TRUE(skiplist.Contains("zzzzzzzzzz"));
+  ASSERT_FALSE(skiplist.Contains(first));
+  expected.erase(first);
+  expected.insert("zzzzzzzzzz");
+  ASSERT_EQ(skiplist.GetElementsByRange(0, -1),
+            std::vector<std::string>(expected.begin(), expected.end()));
+}
+
+template <typename List, typename Set>
+void CheckSearchIndex(List& skiplist, const Set& expected) {
+  std::vector<typename Set::value_type> keys(expected.begin(), expected.end());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_TRUE(skiplist.Contains(keys[i]));
+    ASSERT_EQ(skiplist.GetRankofElement(keys[i]), i);
+    ASSERT_EQ(skiplist.GetElementByRank(i), keys[i]);
+    ASSERT_FALSE(skiplist.Contains(keys[i] + 1));
+    auto found = skiplist.LowerBound(keys[i] + 1);
+    if (i + 1 < keys.size()) {
+      ASSERT_EQ(*found, keys[i + 1]);
+    } else {
+      ASSERT_TRUE(found == skiplist.End());
+    }
+  }
+}
+
+TEST(SearchIndexTest, IntegerKeys) {
+  Skiplist<int64_t, IntegerCompare<int64_t>> skiplist(4, IntegerCompare<int64_t>());
+  std::set<int64_t> expected;
+  /* an empty index */
+  skiplist.BuildSearchIndex();
+  ASSERT_FALSE(skiplist.Contains(0));
+
+  std::mt19937_64 rng(11);
+  for (int i = 0; i < 20000; ++i) {
+    /* even keys, both negative and positive */
+    int64_t key = static_cast<int64_t>(rng() % 200000) * 2 - 200000;
+    ASSERT_EQ(skiplist.Insert(key), expected.insert(key).second);
+  }
+  skiplist.BuildSearchIndex();
+  CheckSearchIndex(skiplist, expected);
+  ASSERT_EQ(skiplist.GetRankofElement(1), -1);
+  ASSERT_EQ(skiplist.GetElementsGt(*expected.rbegin() - 1),
+            std::vector<int64_t>{*expected.rbegin()});
+  ASSERT_EQ(skiplist.GetElementsLt(*expected.begin() + 1), std::vector<int64_t>{*expected.begin()});
+
+  /* writes drop the index, and searches still see them */
+  for (int i = 0; i < 1000; ++i) {
+    int64_t key = static_cast<int64_t>(rng() % 200000) * 2 - 200000;
+    ASSERT_EQ(skiplist.Delete(key), expected.erase(key) > 0);
+  }
+  ASSERT_TRUE(skiplist.Insert(INT64_MIN + 2));
+  expected.insert(INT64_MIN + 2);
+  CheckSearchIndex(skiplist, expected);
+  skiplist.BuildSearchIndex();
+  CheckSearchIndex(skiplist, expected);
+
+  /* the index moves with the keys */
+  Skiplist<int64_t, IntegerCompare<int64_t>> moved(std::move(skiplist));
+  CheckSearchIndex(moved, expected);
+  ASSERT_EQ(skiplist.Size(), 0);
+  ASSERT_FALSE(skiplist.Contains(*expected.begin()));
+  moved.Clear();
+  ASSERT_FALSE(moved.Contains(*expected.begin()));
+}
+
+TEST(SearchIndexTest, UnsignedKeys) {
+  Skiplist<uint64_t, IntegerCompare<uint64_t>> skiplist(4, IntegerCompare<uint64_t>());
+  std::set<uint64_t> expected;
+  std::mt19937_64 rng(13);
+  for (int i = 0; i < 5000; ++i) {
+    /* even keys, about half of them above INT64_MAX */
+    uint64_t key = rng() & ~uint64_t(1);
+    ASSERT_EQ(skiplist.Insert(key), expected.insert(key).second);
+  }
+  skiplist.BuildSearchIndex();
+  CheckSearchIndex(skiplist, expected);
+}
+
+/* check the keys, their ranks and the backward pointers against the expected keys */
+template <typename List>
+void CheckKeys(List& skiplist, const std::vector<int>& expected) {
+  ASSERT_EQ(skiplist.Size(), expected.size());
+  ASSERT_EQ(skiplist.GetElementsByRange(0, -1), expected);
+  ASSERT_EQ(std::vector<int>(skiplist.RBegin(), skiplist.REnd()),
+            std::vector<int>(expected.rbegin(), expected.rend()));
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(skiplist.GetRankofElement(expected[i]), i);
+    ASSERT_EQ(skiplist.GetElementByRank(i), expected[i]);
+  }
+}
+
+template <typename List>
+void CheckDeleteRanges(List& skiplist) {
+  std::vector<int> expected;
+  for (int i = 0; i < 2000; ++i) {
+    skiplist.Insert(i);
+    expected.push_back(i);
+  }
+
+  ASSERT_TRUE(skiplist.DeleteByRank(0));
+  ASSERT_TRUE(skiplist.DeleteByRank(-1));
+  ASSERT_TRUE(skiplist.DeleteByRank(100));
+  ASSERT_FALSE(skiplist.DeleteByRank(2000));
+  expected.erase(expected.begin() + 101);
+  expected.pop_back();
+  expected.erase(expected.begin());
+  CheckKeys(skiplist, expected);
+
+  ASSERT_EQ(skiplist.DeleteRankRange(10, 9), 0);
+  ASSERT_EQ(skiplist.DeleteRankRange(5000, 6000), 0);
+  ASSERT_EQ(skiplist.DeleteRankRange(10, 509), 500);
+  expected.erase(expected.begin() + 10, expected.begin() + 510);
+  /* trim to the first 1000 keys, like ZREMRANGEBYRANK key 1000 -1 */
+  ASSERT_EQ(skiplist.DeleteRankRange(1000, -1), expected.size() - 1000);
+  expected.resize(1000);
+  CheckKeys(skiplist, expected);
+
+  ASSERT_EQ(skiplist.DeleteRange(700, 600), 0);
+  ASSERT_EQ(skiplist.DeleteRange(700, 700), 0);
+  ASSERT_EQ(skiplist.DeleteRange(-100, 520),
+            std::lower_bound(expected.begin(), expected.end(), 520) - expected.begin());
+  ASSERT_EQ(skiplist.DeleteRange(600, 700), 100);
+  expected.erase(std::remove_if(expected.begin(), expected.end(),
+                                [](int key) { return key < 520 || (key >= 600 && key < 700); }),
+                 expected.end());
+  CheckKeys(skiplist, expected);
+
+  /* the skiplist is still usable once emptied */
+  ASSERT_EQ(skiplist.DeleteRange(0, 5000), expected.size());
+  CheckKeys(skiplist, {});
+  ASSERT_EQ(skiplist.DeleteRankRange(0, -1), 0);
+  ASSERT_TRUE(skiplist.Insert(1));
+  ASSERT_TRUE(skiplist.Insert(0));
+  CheckKeys(skiplist, {0, 1});
+}
+
+TEST(DeleteRangeTest, DeleteRanges) {
+  Skiplist<int> skiplist;
+  CheckDeleteRanges(skiplist);
+  ArenaSkiplist<int> arena_skiplist;
+  CheckDeleteRanges(arena_skiplist);
+  /* deleted runs are retired instead */
+  Skiplist<int> concurrent_skiplist;
+  concurrent_skiplist.EnableConcurrentReads();
+  CheckDeleteRanges(concurrent_skiplist);
+}
+
+TEST(SplitTest, SplitAndConcat) {
+  Skiplist<int> skiplist;
+  std::vector<int> expected;
+  for (int i = 0; i < 3000; ++i) {
+    skiplist.Insert(i * 2);
+    expected.push_back(i * 2);
+  }
+
+  Skiplist<int> right = skiplist.SplitAtRank(1000);
+  CheckKeys(skiplist, std::vector<int>(expected.begin(), expected.begin() + 1000));
+  CheckKeys(right, std::vector<int>(expected.begin() + 1000, expected.end()));
+  /* keys not less than the key move, so the key itself moves */
+  Skiplist<int> middle = right.SplitAt(4000);
+  CheckKeys(right, std::vector<int>(expected.begin() + 1000, expected.begin() + 2000));
+  CheckKeys(middle, std::vector<int>(expected.begin() + 2000, expected.end()));
+  Skiplist<int> empty = middle.SplitAt(6001);
+  CheckKeys(empty, {});
+  Skiplist<int> all = middle.SplitAtRank(0);
+  CheckKeys(middle, {});
+  CheckKeys(all, std::vector<int>(expected.begin() + 2000, expected.end()));
+
+  /* overlapping keys are rejected, and both skiplists are left as they were */
+  ASSERT_THROW(all.Concat(right), std::invalid_argument);
+  CheckKeys(right, std::vector<int>(expected.begin() + 1000, expected.begin() + 2000));
+  right.Concat(all);
+  CheckKeys(all, {});
+  skiplist.Concat(empty);
+  skiplist.Concat(right);
+  CheckKeys(right, {});
+  CheckKeys(skiplist, expected);
+
+  /* the split skiplists are still writable */
+  ASSERT_TRUE(right.Insert(1));
+  ASSERT_TRUE(all.Insert(3));
+  ASSERT_TRUE(skiplist.Insert(6001));
+  ASSERT_TRUE(skiplist.Delete(0));
+  expected.erase(expected.begin());
+  expected.push_back(6001);
+  CheckKeys(skiplist, expected);
+  right.Concat(all);
+  CheckKeys(right, {1, 3});
+
+  /* a skiplist higher than this one */
+  Skiplist<int> low(1), high(16);
+  low.Insert(0);
+  high.Insert(1);
+  low.Concat(high);
+  CheckKeys(low, {0, 1});
+}
+
+template <typename Operation>
+void CheckSetOperations(const std::vector<int>& keys1, const std::vector<int>& keys2,
+                        Operation operation) {
+  Skiplist<int> skiplist1, skiplist2;
+  skiplist1.BulkLoad(keys1.begin(), keys1.end());
+  skiplist2.BulkLoad(keys2.begin(), keys2.end());
+  std::vector<int> expected;
+  auto out = std::back_inserter(expected);
+
+  std::set_union(keys1.begin(), keys1.end(), keys2.begin(), keys2.end(), out);
+  Skiplist<int> result = operation(skiplist1, skiplist2, 0);
+  CheckKeys(result, expected);
+  expected.clear();
+  std::set_intersection(keys1.begin(), keys1.end(), keys2.begin(), keys2.end(), out);
+  result = operation(skiplist1, skiplist2, 1);
+  CheckKeys(result, expected);
+  expected.clear();
+  std::set_difference(keys1.begin(), keys1.end(), keys2.begin(), keys2.end(), out);
+  result = operation(skiplist1, skiplist2, 2);
+  CheckKeys(result, expected);
+  /* the operands are left as they were */
+  CheckKeys(skiplist1, keys1);
+  CheckKeys(skiplist2, keys2);
+}
+
+TEST(SetOperationTest, MatchesStd) {
+  auto operation = [](const Skiplist<int>& s1, const Skiplist<int>& s2, int op) {
+    return op == 0 ? s1.Union(s2) : (op == 1 ? s1.Intersect(s2) : s1.Difference(s2));
+  };
+  std::mt19937 rng(23);
+  auto random_keys = [&rng](size_t n, int range) {
+    std::set<int> keys;
+    while (keys.size() < n) {
+      keys.insert(rng() % range);
+    }
+    return std::vector<int>(keys.begin(), keys.end());
+  };
+
+  CheckSetOperations({}, {}, operation);
+  CheckSetOperations({1, 2, 3}, {}, operation);
+  CheckSetOperations({}, {1, 2, 3}, operation);
+  CheckSetOperations(random_keys(1000, 3000), random_keys(1000, 3000), operation);
+  /* sizes far apart, where the larger skiplist is skipped through */
+  CheckSetOperations(random_keys(5000, 100000), random_keys(20, 100000), operation);
+  CheckSetOperations(random_keys(20, 100000), random_keys(5000, 100000), operation);
+  std::vector<int> large = random_keys(5000, 100000);
+  std::vector<int> sample;
+  for (size_t i = 0; i < large.size(); i += 250) {
+    sample.push_back(large[i]);
+  }
+  CheckSetOperations(large, sample, operation);
+  CheckSetOperations(sample, large, operation);
+}
+
+TEST(SetOperationTest, Duplicates) {
+  std::vector<int> keys1 = {1, 1, 1, 2, 3, 3}, keys2 = {1, 3, 3, 3, 4};
+  Skiplist<int> skiplist1, skiplist2;
+  skiplist1.EnableDuplicates();
+  skiplist2.EnableDuplicates();
+  skiplist1.BulkLoad(keys1.begin(), keys1.end());
+  skiplist2.BulkLoad(keys2.begin(), keys2.end());
+  ASSERT_EQ(skiplist1.Union(skiplist2).GetElementsByRange(0, -1),
+            std::vector<int>({1, 1, 1, 2, 3, 3, 3, 4}));
+  ASSERT_EQ(skiplist1.Intersect(skiplist2).GetElementsByRange(0, -1),
+            std::vector<int>({1, 3, 3}));
+  ASSERT_EQ(skiplist1.Difference(skiplist2).GetElementsByRange(0, -1),
+            std::vector<int>({1, 1, 2}));
+}
+
+TEST(SetOperationTest, MergeAndIntersectMany) {
+  std::mt19937 rng(29);
+  std::vector<Skiplist<int>> skiplists;
+  std::vector<std::set<int>> keys(8);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    skiplists.emplace_back();
+    /* large enough to be partitioned, with keys common to all skiplists */
+    for (int j = 0; j < 20000; ++j) {
+      int key = j % 10 == 0 ? j : static_cast<int>(rng() % 100000);
+      skiplists[i].Insert(key);
+      keys[i].insert(key);
+    }
+  }
+  std::vector<const Skiplist<int>*> others;
+  for (size_t i = 1; i < skiplists.size(); ++i) {
+    others.push_back(&skiplists[i]);
+  }
+
+  std::set<int> merged;
+  for (const std::set<int>& k : keys) {
+    merged.insert(k.begin(), k.end());
+  }
+  std::vector<int> intersected;
+  for (int key : keys[0]) {
+    auto contains = [key](const std::set<int>& k) { return k.count(key) > 0; };
+    if (std::all_of(keys.begin(), keys.end(), contains)) {
+      intersected.push_back(key);
+    }
+  }
+
+  for (size_t threads : {1, 2, 3, 8}) {
+    Skiplist<int> merge = skiplists[0].MergeMany(others, threads);
+    CheckKeys(merge, std::vector<int>(merged.begin(), merged.end()));
+    Skiplist<int> intersect = skiplists[0].IntersectMany(others, threads);
+    CheckKeys(intersect, intersected);
+  }
+
+  /* a single skiplist, and one without keys */
+  Skiplist<int> empty;
+  Skiplist<int> copy = skiplists[0].MergeMany({}, 4);
+  CheckKeys(copy, std::vector<int>(keys[0].begin(), keys[0].end()));
+  Skiplist<int> none = skiplists[0].IntersectMany({&empty, &skiplists[1]}, 4);
+  CheckKeys(none, {});
+
+  /* arena nodes cannot move between skiplists, so the partial results are copied instead */
+  std::vector<ArenaSkiplist<int>> arenas(2);
+  for (size_t i = 0; i < arenas.size(); ++i) {
+    arenas[i].BulkLoad(keys[i].begin(), keys[i].end());
+  }
+  std::set<int> arena_merged(keys[0]);
+  arena_merged.insert(keys[1].begin(), keys[1].end());
+  ArenaSkiplist<int> arena_merge = arenas[0].MergeMany({&arenas[1]}, 4);
+  CheckKeys(arena_merge, std::vector<int>(arena_merged.begin(), arena_merged.end()));
+  ASSERT_TRUE(arena_merge.Insert(-1));
+}
+
+TEST(ParallelRangeTest, MatchesSerial) {
+  Skiplist<int> skiplist;
+  for (int i = 0; i < 50000; ++i) {
+    skiplist.Insert(i * 2);
+  }
+
+  for (size_t threads : {0, 1, 3, 8}) {
+    ASSERT_EQ(skiplist.GetElementsByRange(0, -1, threads), skiplist.GetElementsByRange(0, -1));
+    ASSERT_EQ(skiplist.GetElementsByRange(123, 45678, threads),
+              skiplist.GetElementsByRange(123, 45678));
+    ASSERT_EQ(skiplist.GetElementsByRange(-20000, -1, threads),
+              skiplist.GetElementsByRange(-20000, -1));
+    ASSERT_EQ(skiplist.GetElementsByRange(49990, 60000, threads),
+              skiplist.GetElementsByRange(49990, 60000));
+    ASSERT_TRUE(skiplist.GetElementsByRange(10, 9, threads).empty());
+    ASSERT_TRUE(skiplist.GetElementsByRange(50000, 50001, threads).empty());
+    ASSERT_EQ(skiplist.GetElementsInRange(1001, 90000, threads),
+              skiplist.GetElementsInRange(1001, 90000));
+    ASSERT_TRUE(skiplist.GetElementsInRange(5, 5, threads).empty());
+
+    std::atomic<long long> sum(0);
+    std::atomic<size_t> count(0);
+    skiplist.ForEachParallel(
+        [&sum, &count](int key) {
+          sum += key;
+          ++count;
+        },
+        threads);
+    ASSERT_EQ(count.load(), 50000);
+    ASSERT_EQ(sum.load(), 50000LL * 49999);
+  }
+
+  Skiplist<int> empty;
+  ASSERT_TRUE(empty.GetElementsByRange(0, -1, 4).empty());
+  empty.ForEachParallel([](int) { FAIL(); }, 4);
+}
+
+/* records ordered by score only, so that records with the same score are equal keys */
+struct Record {
+  int score;
+  int id;
+  bool operator==(const Record& other) const { return score == other.score && id == other.id; }
+};
+
+struct RecordCompare {
+  int operator()(const Record& r1, const Record& r2) const {
+    return r1.score < r2.score ? -1 : (r1.score == r2.score ? 0 : 1);
+  }
+};
+
+TEST(DuplicatesTest, InsertionOrder) {
+  Skiplist<Record, RecordCompare> skiplist(2, RecordCompare());
+  skiplist.EnableDuplicates();
+  /* a stable sort of the records keeps equal ones in insertion order */
+  std::vector<Record> expected;
+  std::mt19937 rng(19);
+  for (int i = 0; i < 3000; ++i) {
+    Record record{static_cast<int>(rng() % 100), i};
+    ASSERT_TRUE(i % 2 ? skiplist.Insert(record) : skiplist.Emplace(record));
+    expected.push_back(record);
+  }
+  std::vector<Record> batch;
+  for (int i = 0; i < 500; ++i) {
+    batch.push_back({static_cast<int>(i / 5), 3000 + i});
+    expected.push_back(batch.back());
+  }
+  ASSERT_EQ(skiplist.InsertBatch(batch.begin(), batch.end()), batch.size());
+  auto by_score = [](const Record& r1, const Record& r2) { return r1.score < r2.score; };
+  std::stable_sort(expected.begin(), expected.end(), by_score);
+  ASSERT_EQ(skiplist.GetElementsByRange(0, -1), expected);
+
+  std::vector<Record> scores;
+  for (int score = -1; score <= 100; ++score) {
+    Record key{score, 0};
+    auto first = std::lower_bound(expected.begin(), expected.end(), key, by_score);
+    auto last = std::upper_bound(expected.begin(), expected.end(), key, by_score);
+    ASSERT_EQ(skiplist.Count(key), last - first);
+    auto range = skiplist.EqualRange(key);
+    ASSERT_EQ(std::vector<Record>(range.begin(), range.end()), std::vector<Record>(first, last));
+    ASSERT_EQ(skiplist.GetRankofElement(key), first == last ? -1 : first - expected.begin());
+    scores.push_back(key);
+  }
+  std::vector<ssize_t> ranks = skiplist.RankMany(scores.begin(), scores.end());
+  for (size_t i = 0; i < scores.size(); ++i) {
+    ASSERT_EQ(ranks[i], skiplist.GetRankofElement(scores[i]));
+  }
+
+  /* delete and update act on the first equal key, an updated key goes after the equal ones */
+  Record key{50, 0};
+  auto first = std::lower_bound(expected.begin(), expected.end(), key, by_score);
+  ASSERT_TRUE(skiplist.Delete(key));
+  first = expected.erase(first);
+  ASSERT_TRUE(skiplist.Update(key, Record{50, -1}));
+  expected.erase(first);
+  expected.insert(std::upper_bound(expected.begin(), expected.end(), key, by_score),
+                  Record{50, -1});
+  ASSERT_TRUE(skiplist.Update(Record{10, 0}, Record{60, -2}));
+  expected.erase(std::lower_bound(expected.begin(), expected.end(), Record{10, 0}, by_score));
+  expected.insert(std::upper_bound(expected.begin(), expected.end(), Record{60, 0}, by_score),
+                  Record{60, -2});
+  ASSERT_EQ(skiplist.GetElementsByRange(0, -1), expected);
+  ASSERT_EQ(skiplist.Size(), expected.size());
+
+  /* bulk loading keeps equal keys as well */
+  Skiplist<Record, RecordCompare> loaded(2, RecordCompare());
+  loaded.EnableDuplicates();
+  loaded.BulkLoad(expected.begin(), expected.end());
+  ASSERT_EQ(loaded.GetElementsByRange(0, -1), expected);
+}
+
+TEST(DuplicatesTest, UniqueByDefault) {
+  Skiplist<int> skiplist;
+  ASSERT_TRUE(skiplist.Insert(1));
+  ASSERT_FALSE(skiplist.Insert(1));
+  ASSERT_EQ(skiplist.Count(1), 1);
+  ASSERT_EQ(skiplist.Count(2), 0);
+  ASSERT_EQ(std::distance(skiplist.EqualRange(2).begin(), skiplist.EqualRange(2).end()), 0);
+
+  skiplist.EnableDuplicates();
+  ASSERT_TRUE(skiplist.Insert(1));
+  ASSERT_EQ(skiplist.Count(1), 2);
+  ASSERT_TRUE(skiplist.Update(1, 1));
+  ASSERT_EQ(skiplist.Count(1), 2);
+}
+
+TEST(ConcurrentReadsTest, SingleWriterMultipleReaders) {
+  Skiplist<int> skiplist(4);
+  skiplist.EnableConcurrentReads();
+  for (int i = 0; i < 1000; i += 2) {
+    ASSERT_TRUE(skiplist.Insert(i));
+  }
+
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&skiplist, &done]() {
+      while (!done.load()) {
+        /* even keys are never deleted */
+        for (int i = 0; i < 1000; i += 50) {
+          EXPECT_TRUE(skiplist.Contains(i));
+          EXPECT_GE(skiplist.GetRankofElement(i), 0);
+        }
+        const std::vector<int>& keys = skiplist.GetElementsInRange(100, 200);
+        EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+        int prev = -1;
+        for (auto it = skiplist.Begin(); it != skiplist.End(); ++it) {
+          EXPECT_LT(prev, *it);
+          prev = *it;
+        }
+        prev = INT_MAX;
+        for (int key : skiplist.RevRange(0, 100)) {
+          EXPECT_GT(prev, key);
+          prev = key;
+        }
+      }
+    });
+  }
+
+  for (int round = 0; round < 20; ++round) {
+    for (int i = 1; i < 1000; i += 2) {
+      ASSERT_TRUE(skiplist.Insert(i));
+    }
+    for (int i = 1; i < 1000; i += 4) {
+      ASSERT_TRUE(skiplist.Update(i, i + 2000));
+    }
+    for (int i = 1; i < 1000; i += 4) {
+      ASSERT_TRUE(skiplist.Delete(i + 2000));
+      ASSERT_TRUE(skiplist.Delete(i + 2));
+    }
+    for (int i = 1000; i < 1100; ++i) {
+      ASSERT_TRUE(skiplist.Insert(i));
+    }
+    ASSERT_EQ(skiplist.DeleteRange(1000, 1100), 100);
+  }
+  done.store(true);
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  ASSERT_EQ(skiplist.Size(), 500);
+  ASSERT_EQ(skiplist.GetRankofElement(998), 499);
+  skiplist.Clear();
+  ASSERT_EQ(skiplist.Size(), 0);
+  ASSERT_FALSE(skiplist.Contains(0));
+}
+
+TEST(ArenaSkiplistTest, InsertionAndClear) {
+  ArenaSkiplist<std::string> skiplist(4);
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(skiplist.Insert("key" + std::to_string(i)));
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    ASSERT_TRUE(skiplist.Delete("key" + std::to_string(i)));
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    ASSERT_TRUE(skiplist.Insert("key" + std::to_string(i)));
+  }
+  ASSERT_EQ(skiplist.Size(), 1000);
+  ASSERT_EQ(skiplist[0], "key0");
+  ASSERT_EQ(skiplist[999], "key999");
+
+  skiplist.Clear();
+  ASSERT_EQ(skiplist.Size(), 0);
+  ASSERT_FALSE(skiplist.Contains("key0"));
+  ASSERT_TRUE(skiplist.Insert("key0"));
+  ASSERT_EQ(skiplist[0], "key0");
+}
 }  // namespace skiplist
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace skiplist {
+
+/*
+ * Key codecs.
+ *
+ * A key codec turns a key into bytes and back for snapshots. Encode(key, bytes) appends the bytes
+ * of the key to `bytes`, and Decode(data, size) rebuilds the key, throwing std::invalid_argument
+ * if the bytes are malformed. KeyCodec covers arithmetic keys, stored in little-endian order, and
+ * std::string keys, stored as is. Other keys need a codec of their own.
+ */
+template <typename Key, typename = void>
+struct KeyCodec;
+
+template <typename Key>
+struct KeyCodec<Key, typename std::enable_if<std::is_arithmetic<Key>::value>::type> {
+  void Encode(const Key& key, std::string* bytes) const {
+    char raw[sizeof(Key)];
+    memcpy(raw, &key, sizeof(Key));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    std::reverse(raw, raw + sizeof(Key));
+#endif
+    bytes->append(raw, sizeof(Key));
+  }
+  Key Decode(const char* data, size_t size) const {
+    if (size != sizeof(Key)) throw std::invalid_argument("skiplist snapshot key size mismatch");
+    char raw[sizeof(Key)];
+    memcpy(raw, data, sizeof(Key));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    std::reverse(raw, raw + sizeof(Key));
+#endif
+    Key key;
+    memcpy(&key, raw, sizeof(Key));
+    return key;
+  }
+};
+
+template <>
+struct KeyCodec<std::string> {
+  void Encode(const std::string& key, std::string* bytes) const { bytes->append(key); }
+  std::string Decode(const char* data, size_t size) const { return std::string(data, size); }
+};
+
+/*
+ * Snapshot format, version 1. Integers are little-endian.
+ *
+ *   magic "SKIPLIST" | version u32 | flags u32
+ *   records of: key length + 1 varint | key bytes, ended by a 0 byte
+ *   count u64
+ *   checksum u64, if Checksum is set in flags
+ *
+ * The keys are stored in ascending order. The checksum is the 64-bit FNV-1a hash of everything
+ * after the version. The count of records follows them rather than leading them, since a skiplist
+ * with concurrent reads may be saved while keys are inserted and deleted, and the records written
+ * are only known once the last one is; the reader checks it against the records it read.
+ * The writer goes through a buffer of BufferSize bytes, so that the stream is called once per
+ * buffer instead of once per key. The reader reads exactly the bytes of the snapshot from the
+ * stream buffer, so that whatever follows the snapshot in the stream is left unread.
+ */
+class SnapshotWriter {
+ public:
+  static constexpr const uint32_t Version = 1;
+  /* flags */
+  static constexpr const uint32_t Checksum = 1;
+  static constexpr const uint32_t Duplicates = 2;
+  SnapshotWriter(std::ostream& out, uint32_t flags);
+  void WriteKey(const std::string& bytes);
+  /* write the end of the records, the count and the checksum, and check that all was written */
+  void Finish();
+
+ private:
+  template <typename Int>
+  void WriteFixed(Int value, bool hash = true);
+  void Write(const char* data, size_t size, bool hash = true);
+  void Flush();
+  std::ostream& out_;
+  uint32_t flags_;
+  uint64_t count_;
+  uint64_t hash_;
+  std::vector<char> buffer_;
+};
+
+class SnapshotReader {
+ public:
+  /* read and check the header */
+  explicit SnapshotReader(std::istream& in);
+  uint32_t Flags() const { return flags_; }
+  /* the number of keys read so far */
+  uint64_t Count() const { return count_; }
+  /* return the bytes of the next key, valid until the next call, or null after the last key */
+  const std::string* ReadKey();
+  /* check the count and the checksum, once ReadKey returned null */
+  void Finish();
+
+ private:
+  template <typename Int>
+  Int ReadFixed(bool hash = true);
+  void Read(char* data, size_t size, bool hash = true);
+  /* mark the stream as failed and throw */
+  [[noreturn]] void Truncated();
+  std::istream& in_;
+  std::streambuf* buffer_;
+  uint32_t flags_;
+  uint64_t count_;
+  uint64_t hash_;
+  std::string key_;
+};
+
+namespace snapshot_internal {
+constexpr const size_t BufferSize = 64 * 1024;
+constexpr const char Magic[8] = {'S', 'K', 'I', 'P', 'L', 'I', 'S', 'T'};
+constexpr const uint64_t FnvOffset = 0xcbf29ce484222325;
+constexpr const uint64_t FnvPrime = 0x100000001b3;
+
+inline uint64_t Hash(uint64_t hash, const char* data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * FnvPrime;
+  }
+  return hash;
+}
+}  // namespace snapshot_internal
+
+inline SnapshotWriter::SnapshotWriter(std::ostream& out, uint32_t flags)
+    : out_(out), flags_(flags), count_(0), hash_(snapshot_internal::FnvOffset) {
+  buffer_.reserve(snapshot_internal::BufferSize);
+  Write(snapshot_internal::Magic, sizeof(snapshot_internal::Magic), false);
+  WriteFixed(Version, false);
+  WriteFixed(flags);
+}
+
+inline void SnapshotWriter::WriteKey(const std::string& bytes) {
+  /* 7 bits per byte, the high bit set on every byte but the last */
+  char varint[10];
+  size_t size = 0;
+  uint64_t length = bytes.size() + 1;
+  do {
+    varint[size++] = static_cast<char>((length & 0x7f) | (length > 0x7f ? 0x80 : 0));
+    length >>= 7;
+  } while (length > 0);
+  Write(varint, size);
+  Write(bytes.data(), bytes.size());
+  ++count_;
+}
+
+inline void SnapshotWriter::Finish() {
+  const char end = 0;
+  Write(&end, 1);
+  WriteFixed(count_);
+  if (flags_ & Checksum) WriteFixed(hash_, false);
+  Flush();
+  out_.flush();
+  if (!out_) throw std::runtime_error("skiplist snapshot write failed");
+}
+
+template <typename Int>
+void SnapshotWriter::WriteFixed(Int value, bool hash) {
+  char raw[sizeof(Int)];
+  for (size_t i = 0; i < sizeof(Int); ++i) {
+    raw[i] = static_cast<char>(value >> (8 * i));
+  }
+  Write(raw, sizeof(Int), hash);
+}
+
+inline void SnapshotWriter::Write(const char* data, size_t size, bool hash) {
+  if (hash) hash_ = snapshot_internal::Hash(hash_, data, size);
+  if (buffer_.size() + size > snapshot_internal::BufferSize) Flush();
+  if (size >= snapshot_internal::BufferSize) {
+    out_.write(data, size);
+  } else {
+    buffer_.insert(buffer_.end(), data, data + size);
+  }
+}
+
+inline void SnapshotWriter::Flush() {
+  out_.write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+inline SnapshotReader::SnapshotReader(std::istream& in)
+    : in_(in), buffer_(in.rdbuf()), count_(0), hash_(snapshot_internal::FnvOffset) {
+  if (!in_ || !buffer_) Truncated();
+  char magic[sizeof(snapshot_internal::Magic)];
+  Read(magic, sizeof(magic), false);
+  if (memcmp(magic, snapshot_internal::Magic, sizeof(magic)) != 0) {
+    throw std::invalid_argument("skiplist snapshot has no valid header");
+  }
+  if (ReadFixed<uint32_t>(false) != SnapshotWriter::Version) {
+    throw std::invalid_argument("skiplist snapshot version is not supported");
+  }
+  flags_ = ReadFixed<uint32_t>();
+}
+
+inline const std::string* SnapshotReader::ReadKey() {
+  uint64_t length = 0;
+  for (int shift = 0;; shift += 7) {
+    if (shift > 63) throw std::invalid_argument("skiplist snapshot key length is malformed");
+    int byte = buffer_->sbumpc();
+    if (byte == std::char_traits<char>::eof()) Truncated();
+    char c = static_cast<char>(byte);
+    hash_ = snapshot_internal::Hash(hash_, &c, 1);
+    length |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) break;
+  }
+  if (length == 0) return nullptr;
+  --length;
+  /* grow with the bytes actually read, so that a corrupted length cannot exhaust memory */
+  key_.clear();
+  while (length > 0) {
+    size_t size = std::min<uint64_t>(length, snapshot_internal::BufferSize);
+    size_t offset = key_.size();
+    key_.resize(offset + size);
+    Read(&key_[offset], size);
+    length -= size;
+  }
+  ++count_;
+  return &key_;
+}
+
+inline void SnapshotReader::Finish() {
+  if (ReadFixed<uint64_t>() != count_) {
+    throw std::invalid_argument("skiplist snapshot count mismatch");
+  }
+  if (!(flags_ & SnapshotWriter::Checksum)) return;
+  uint64_t expected = hash_;
+  if (ReadFixed<uint64_t>(false) != expected) {
+    throw std::invalid_argument("skiplist snapshot checksum mismatch");
+  }
+}
+
+template <typename Int>
+Int SnapshotReader::ReadFixed(bool hash) {
+  unsigned char raw[sizeof(Int)];
+  Read(reinterpret_cast<char*>(raw), sizeof(Int), hash);
+  Int value = 0;
+  for (size_t i = 0; i < sizeof(Int); ++i) {
+    value |= static_cast<Int>(raw[i]) << (8 * i);
+  }
+  return value;
+}
+
+inline void SnapshotReader::Read(char* data, size_t size, bool hash) {
+  if (buffer_->sgetn(data, size) != static_cast<std::streamsize>(size)) Truncated();
+  if (hash) hash_ = snapshot_internal::Hash(hash_, data, size);
+}
+
+inline void SnapshotReader::Truncated() {
+  in_.setstate(std::ios::eofbit | std::ios::failbit);
+  throw std::invalid_argument("skiplist snapshot is truncated");
+}
+
+}  // namespace skiplist
@@ -0,0 +1,272 @@
+#include "snapshot.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "skiplist.h"
+
+namespace skiplist {
+TEST(SnapshotTest, KeyCodec) {
+  std::string bytes;
+  KeyCodec<uint32_t>().Encode(0x01020304, &bytes);
+  ASSERT_EQ(bytes, std::string("\x04\x03\x02\x01", 4));
+  ASSERT_EQ(KeyCodec<uint32_t>().Decode(bytes.data(), bytes.size()), 0x01020304);
+  ASSERT_THROW(KeyCodec<uint64_t>().Decode(bytes.data(), bytes.size()), std::invalid_argument);
+
+  bytes.clear();
+  KeyCodec<double>().Encode(-1.5, &bytes);
+  ASSERT_EQ(KeyCodec<double>().Decode(bytes.data(), bytes.size()), -1.5);
+  ASSERT_EQ(KeyCodec<std::string>().Decode("key", 3), "key");
+}
+
+TEST(SnapshotTest, Format) {
+  std::ostringstream out;
+  SnapshotWriter writer(out, 0);
+  writer.WriteKey("");
+  writer.WriteKey(std::string(200, 'k'));
+  writer.Finish();
+
+  /* header, a 1 byte and a 2 byte length, the end and the count, without a checksum */
+  std::string data = out.str();
+  ASSERT_EQ(data.size(), 16 + 1 + 2 + 200 + 1 + 8);
+  ASSERT_EQ(data.substr(0, 12), std::string("SKIPLIST\x01\0\0\0", 12));
+  ASSERT_EQ(data.substr(16, 3), std::string("\x01\xc9\x01", 3));
+  ASSERT_EQ(data.substr(219), std::string("\0\x02\0\0\0\0\0\0\0", 9));
+
+  std::istringstream in(data);
+  SnapshotReader reader(in);
+  ASSERT_EQ(reader.Flags(), 0);
+  ASSERT_EQ(*reader.ReadKey(), "");
+  ASSERT_EQ(*reader.ReadKey(), std::string(200, 'k'));
+  ASSERT_EQ(reader.ReadKey(), nullptr);
+  ASSERT_EQ(reader.Count(), 2);
+  reader.Finish();
+}
+
+TEST(SnapshotTest, SaveAndLoad) {
+  Skiplist<std::string> skiplist;
+  for (int i = 0; i < 1000; ++i) {
+    skiplist.Insert("key" + std::to_string(i));
+  }
+
+  for (bool checksum : {true, false}) {
+    std::stringstream stream;
+    skiplist.SaveSnapshot(stream, checksum);
+    Skiplist<std::string> loaded;
+    loaded.Insert("stale");
+    loaded.LoadSnapshot(stream);
+    ASSERT_EQ(loaded.GetElementsByRange(0, -1), skiplist.GetElementsByRange(0, -1));
+    ASSERT_EQ(loaded.GetRankofElement("key500"), skiplist.GetRankofElement("key500"));
+    ASSERT_TRUE(loaded.Insert("key"));
+  }
+
+  /* integer keys, with duplicates, into an arena */
+  Skiplist<int> integers;
+  integers.EnableDuplicates();
+  for (int i = 0; i < 100; ++i) {
+    integers.Insert(-i / 2);
+  }
+  std::stringstream stream;
+  integers.SaveSnapshot(stream);
+  ArenaSkiplist<int> loaded;
+  loaded.LoadSnapshot(stream);
+  ASSERT_EQ(loaded.GetElementsByRange(0, -1), integers.GetElementsByRange(0, -1));
+  ASSERT_EQ(loaded.Count(-10), 2);
+  ASSERT_TRUE(loaded.Insert(0));
+
+  /* skiplists that allow concurrent reads retire their nodes instead */
+  std::stringstream concurrent_stream;
+  integers.SaveSnapshot(concurrent_stream);
+  Skiplist<int> concurrent;
+  concurrent.EnableConcurrentReads();
+  concurrent.Insert(1);
+  concurrent.LoadSnapshot(concurrent_stream);
+  ASSERT_EQ(concurrent.GetElementsByRange(0, -1), integers.GetElementsByRange(0, -1));
+  concurrent_stream.seekg(0);
+  loaded.EnableConcurrentReads();
+  loaded.LoadSnapshot(concurrent_stream);
+  ASSERT_EQ(loaded.GetElementsByRange(0, -1), integers.GetElementsByRange(0, -1));
+
+  /* an empty skiplist */
+  std::stringstream empty_stream;
+  Skiplist<int>().SaveSnapshot(empty_stream);
+  loaded.LoadSnapshot(empty_stream);
+  ASSERT_EQ(loaded.Size(), 0);
+
+  /* snapshots back to back in one stream, followed by other data */
+  std::stringstream many;
+  Skiplist<int> first, second;
+  first.Insert(1);
+  second.Insert(2);
+  second.Insert(3);
+  first.SaveSnapshot(many);
+  second.SaveSnapshot(many, false);
+  many << "tail";
+  loaded.LoadSnapshot(many);
+  ASSERT_EQ(loaded.GetElementsByRange(0, -1), std::vector<int>({1}));
+  loaded.LoadSnapshot(many);
+  ASSERT_EQ(loaded.GetElementsByRange(0, -1), std::vector<int>({2, 3}));
+  std::string tail;
+  many >> tail;
+  ASSERT_EQ(tail, "tail");
+}
+
+TEST(SnapshotTest, Corruption) {
+  Skiplist<int> skiplist;
+  for (int i = 0; i < 100; ++i) {
+    skiplist.Insert(i);
+  }
+  std::ostringstream out;
+  skiplist.SaveSnapshot(out);
+  const std::string data = out.str();
+
+  auto load = [](const std::string& data) {
+    std::istringstream in(data);
+    Skiplist<int> loaded;
+    loaded.Insert(-1);
+    try {
+      loaded.LoadSnapshot(in);
+    } catch (const std::invalid_argument&) {
+      /* a failed load leaves the skiplist unchanged, and does not enable duplicates */
+      EXPECT_EQ(loaded.GetElementsByRange(0, -1), std::vector<int>({-1}));
+      EXPECT_FALSE(loaded.Insert(-1));
+      throw;
+    }
+  };
+  ASSERT_NO_THROW(load(data));
+  ASSERT_THROW(load(""), std::invalid_argument);
+  ASSERT_THROW(load("SKIPLIST\x02" + data.substr(9)), std::invalid_argument);
+  ASSERT_THROW(load(data.substr(0, data.size() - 1)), std::invalid_argument);
+  ASSERT_THROW(load(data.substr(0, 100)), std::invalid_argument);
+  std::string flipped = data;
+  flipped[100] ^= 1;
+  ASSERT_THROW(load(flipped), std::invalid_argument);
+
+  /* keys out of order */
+  std::ostringstream unsorted;
+  SnapshotWriter writer(unsorted, 0);
+  std::string bytes;
+  KeyCodec<int>().Encode(2, &bytes);
+  writer.WriteKey(bytes);
+  writer.WriteKey(bytes);
+  writer.Finish();
+  ASSERT_THROW(load(unsorted.str()), std::invalid_argument);
+
+  /* a count that does not match the records */
+  std::ostringstream unchecked;
+  skiplist.SaveSnapshot(unchecked, false);
+  std::string miscounted = unchecked.str();
+  ASSERT_NO_THROW(load(miscounted));
+  miscounted[miscounted.size() - 8] ^= 1;
+  ASSERT_THROW(load(miscounted), std::invalid_argument);
+
+  /* equal keys with a corrupted checksum */
+  Skiplist<int> duplicates;
+  duplicates.EnableDuplicates();
+  duplicates.Insert(5);
+  duplicates.Insert(5);
+  std::ostringstream with_duplicates;
+  duplicates.SaveSnapshot(with_duplicates);
+  std::string corrupted = with_duplicates.str();
+  corrupted.back() ^= 1;
+  ASSERT_THROW(load(corrupted), std::invalid_argument);
+}
+
+TEST(SnapshotTest, SaveWhileWriting) {
+  Skiplist<int> skiplist;
+  skiplist.EnableConcurrentReads();
+  for (int i = 0; i < 10000; i += 2) {
+    skiplist.Insert(i);
+  }
+
+  /* readers save while the writer inserts and deletes the odd keys */
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 2; ++t) {
+    readers.emplace_back([&skiplist, &done]() {
+      do {
+        std::stringstream stream;
+        skiplist.SaveSnapshot(stream);
+        Skiplist<int> loaded;
+        ASSERT_NO_THROW(loaded.LoadSnapshot(stream));
+        /* even keys are never deleted */
+        EXPECT_GE(loaded.Size(), 5000);
+        for (int i = 0; i < 10000; i += 500) {
+          EXPECT_TRUE(loaded.Contains(i));
+        }
+      } while (!done.load());
+    });
+  }
+
+  for (int round = 0; round < 20; ++round) {
+    for (int i = 1; i < 10000; i += 2) {
+      ASSERT_TRUE(skiplist.Insert(i));
+    }
+    for (int i = 1; i < 10000; i += 2) {
+      ASSERT_TRUE(skiplist.Delete(i));
+    }
+  }
+  done.store(true);
+  for (auto& reader : readers) {
+    reader.join();
+  }
+}
+
+TEST(SnapshotTest, LoadWhileReading) {
+  /* even keys, and odd keys twice each */
+  Skiplist<int> evens, odds;
+  odds.EnableDuplicates();
+  for (int i = 0; i < 1000; i += 2) {
+    evens.Insert(i);
+    odds.Insert(i + 1);
+    odds.Insert(i + 1);
+  }
+  std::stringstream even_stream, odd_stream;
+  evens.SaveSnapshot(even_stream);
+  odds.SaveSnapshot(odd_stream);
+
+  Skiplist<int> skiplist;
+  skiplist.EnableConcurrentReads();
+  skiplist.LoadSnapshot(even_stream);
+
+  /* every reader sees all keys of one snapshot, never a partly loaded or empty skiplist */
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&skiplist, &done]() {
+      do {
+        std::vector<int> keys;
+        for (auto it = skiplist.Begin(); it != skiplist.End(); ++it) {
+          keys.push_back(*it);
+        }
+        ASSERT_FALSE(keys.empty());
+        const bool odd = keys[0] % 2 == 1;
+        ASSERT_EQ(keys.size(), odd ? 1000 : 500);
+        for (size_t i = 0; i < keys.size(); ++i) {
+          ASSERT_EQ(keys[i], odd ? static_cast<int>(i / 2 * 2 + 1) : static_cast<int>(i * 2));
+        }
+        skiplist.Contains(500);
+      } while (!done.load());
+    });
+  }
+
+  for (int round = 0; round < 200; ++round) {
+    std::stringstream& stream = round % 2 == 0 ? odd_stream : even_stream;
+    stream.clear();
+    stream.seekg(0);
+    skiplist.LoadSnapshot(stream);
+  }
+  done.store(true);
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  ASSERT_EQ(skiplist.Size(), 500);
+  ASSERT_TRUE(skiplist.Insert(0));
+  ASSERT_EQ(skiplist.Count(0), 2);
+}
+}  // namespace skiplist
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "skiplist.h"
+
+namespace skiplist {
+
+template <typename Member, typename Score>
+struct SortedMapEntry {
+  Member member_;
+  Score score_;
+};
+
+/*
+ * SortedMap maps unique members to scores, like redis' zset.
+ *
+ * Entries are kept in a skiplist ordered by (score, member), and a hash index embedded in the
+ * map points from each member straight to its skiplist node, so a member is stored only once and
+ * looking it up costs a single hash probe. Changing a score moves the node in place and only
+ * relinks it when its position changes.
+ */
+template <typename Member, typename Score = double, typename Hash = std::hash<Member>,
+          typename Allocator = HeapAllocator>
+class SortedMap {
+ public:
+  using Entry = SortedMapEntry<Member, Score>;
+
+  SortedMap();
+  explicit SortedMap(const size_t level);
+  bool Upsert(const Member& member, const Score& score);
+  Score IncrBy(const Member& member, const Score& delta);
+  bool Delete(const Member& member);
+  bool Contains(const Member& member) const;
+  bool GetScore(const Member& member, Score* score) const;
+  ssize_t GetRankofMember(const Member& member);
+  const Entry& GetElementByRank(int rank) { return skiplist_.GetElementByRank(rank); }
+  std::vector<Entry> GetElementsByRange(int start, int end);
+  std::vector<Entry> GetElementsByRevRange(int start, int end);
+  std::vector<Entry> GetElementsByScore(const Score& min, const Score& max);
+  size_t Size() { return skiplist_.Size(); }
+  void Clear();
+
+ private:
+  struct EntryComparator {
+    int operator()(const Entry& e1, const Entry& e2) const {
+      if (e1.score_ < e2.score_) return -1;
+      if (e2.score_ < e1.score_) return 1;
+      return default_compare<Member>(e1.member_, e2.member_);
+    }
+  };
+  using List = Skiplist<Entry, EntryComparator, Allocator>;
+  using SkiplistNode = typename List::SkiplistNode;
+  class HashIndex;
+  List skiplist_;
+  HashIndex index_;
+};
+
+/*
+ * HashIndex
+ *
+ * An open addressing hash table of skiplist nodes, keyed by the member stored in each node.
+ * Deleted slots are marked with a tombstone until the next rehash.
+ */
+template <typename Member, typename Score, typename Hash, typename Allocator>
+class SortedMap<Member, Score, Hash, Allocator>::HashIndex {
+ public:
+  HashIndex() : used_(0), size_(0) {}
+  SkiplistNode* Find(const Member& member) const;
+  void Insert(SkiplistNode* node);
+  void Erase(const Member& member);
+  void Clear();
+
+ private:
+  static constexpr const size_t InitCapacity = 16;
+  static SkiplistNode* Tombstone() { return reinterpret_cast<SkiplistNode*>(uintptr_t(1)); }
+  size_t FindSlot(const Member& member) const;
+  void Rehash(size_t capacity);
+  std::vector<SkiplistNode*> slots_;
+  /* number of slots holding a node or a tombstone */
+  size_t used_;
+  size_t size_;
+  Hash hash_;
+};
+
+/* return the slot holding the member, or slots_.size() if the member is not indexed */
+template <typename Member, typename Score, typename Hash, typename Allocator>
+size_t SortedMap<Member, Score, Hash, Allocator>::HashIndex::FindSlot(const Member& member) const {
+  if (slots_.empty()) return 0;
+
+  size_t mask = slots_.size() - 1;
+  for (size_t i = hash_(member) & mask;; i = (i + 1) & mask) {
+    const SkiplistNode* node = slots_[i];
+    if (!node) return slots_.size();
+    if (node != Tombstone() && node->key_.member_ == member) return i;
+  }
+}
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+typename SortedMap<Member, Score, Hash, Allocator>::SkiplistNode*
+SortedMap<Member, Score, Hash, Allocator>::HashIndex::Find(const Member& member) const {
+  size_t i = FindSlot(member);
+  return i < slots_.size() ? slots_[i] : nullptr;
+}
+
+/* the caller must make sure the member is not indexed yet */
+template <typename Member, typename Score, typename Hash, typename Allocator>
+void SortedMap<Member, Score, Hash, Allocator>::HashIndex::Insert(SkiplistNode* node) {
+  /* keep the load factor, tombstones included, at most 1/2 */
+  if ((used_ + 1) * 2 > slots_.size()) {
+    size_t capacity = InitCapacity;
+    while (capacity < (size_ + 1) * 4) capacity *= 2;
+    Rehash(capacity);
+  }
+
+  size_t mask = slots_.size() - 1;
+  size_t i = hash_(node->key_.member_) & mask;
+  while (slots_[i] && slots_[i] != Tombstone()) {
+    i = (i + 1) & mask;
+  }
+  if (!slots_[i]) ++used_;
+  slots_[i] = node;
+  ++size_;
+}
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+void SortedMap<Member, Score, Hash, Allocator>::HashIndex::Erase(const Member& member) {
+  size_t i = FindSlot(member);
+  if (i == slots_.size()) return;
+  slots_[i] = Tombstone();
+  --size_;
+}
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+void SortedMap<Member, Score, Hash, Allocator>::HashIndex::Clear() {
+  slots_.clear();
+  used_ = 0;
+  size_ = 0;
+}
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+void SortedMap<Member, Score, Hash, Allocator>::HashIndex::Rehash(size_t capacity) {
+  std::vector<SkiplistNode*> slots(capacity, nullptr);
+  size_t mask = capacity - 1;
+  for (SkiplistNode* node : slots_) {
+    if (!node || node == Tombstone()) continue;
+    size_t i = hash_(node->key_.member_) & mask;
+    while (slots[i]) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = node;
+  }
+  slots_.swap(slots);
+  used_ = size_;
+}
+
+/* SortedMap */
+template <typename Member, typename Score, typename Hash, typename Allocator>
+SortedMap<Member, Score, Hash, Allocator>::SortedMap()
+    : skiplist_(List::InitSkiplistLevel, EntryComparator()) {}
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+SortedMap<Member, Score, Hash, Allocator>::SortedMap(const size_t level)
+    : skiplist_(level, EntryComparator()) {}
+
+/*
+ * set the score of a member, adding the member if it does not exist.
+ * return true if the member is added.
+ */
+template <typename Member, typename Score, typename Hash, typename Allocator>
+bool SortedMap<Member, Score, Hash, Allocator>::Upsert(const Member& member, const Score& score) {
+  SkiplistNode* node = index_.Find(member);
+  if (!node) {
+    index_.Insert(skiplist_.InsertNode(Entry{member, score}));
+    return true;
+  }
+
+  if (!(node->key_.score_ < score) && !(score < node->key_.score_)) return false;
+
+  /* members are unique, so the node never collides with another one and keeps its address */
+  skiplist_.UpdateNode(node->key_, [&score](Entry& e) { e.score_ = score; });
+  return false;
+}
+
+/*
+ * add delta to the score of a member, adding the member with a score of delta if it does not
+ * exist. return the new score.
+ */
+template <typename Member, typename Score, typename Hash, typename Allocator>
+Score SortedMap<Member, Score, Hash, Allocator>::IncrBy(const Member& member, const Score& delta) {
+  SkiplistNode* node = index_.Find(member);
+  if (!node) {
+    index_.Insert(skiplist_.InsertNode(Entry{member, delta}));
+    return delta;
+  }
+
+  Score score = node->key_.score_ + delta;
+  skiplist_.UpdateNode(node->key_, [&score](Entry& e) { e.score_ = score; });
+  return score;
+}
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+bool SortedMap<Member, Score, Hash, Allocator>::Delete(const Member& member) {
+  SkiplistNode* node = index_.Find(member);
+  if (!node) return false;
+
+  /* erase from the index first, the skiplist frees the member */
+  index_.Erase(member);
+  skiplist_.Delete(node->key_);
+  return true;
+}
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+bool SortedMap<Member, Score, Hash, Allocator>::Contains(const Member& member) const {
+  return index_.Find(member) != nullptr;
+}
+
+/*
+ * store the score of the member into `score`.
+ * return false if the member does not exist.
+ */
+template <typename Member, typename Score, typename Hash, typename Allocator>
+bool SortedMap<Member, Score, Hash, Allocator>::GetScore(const Member& member,
+                                                         Score* score) const {
+  const SkiplistNode* node = index_.Find(member);
+  if (!node) return false;
+  *score = node->key_.score_;
+  return true;
+}
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+ssize_t SortedMap<Member, Score, Hash, Allocator>::GetRankofMember(const Member& member) {
+  const SkiplistNode* node = index_.Find(member);
+  if (!node) return -1;
+  return skiplist_.GetRankofElement(node->key_);
+}
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+std::vector<typename SortedMap<Member, Score, Hash, Allocator>::Entry>
+SortedMap<Member, Score, Hash, Allocator>::GetElementsByRange(int start, int end) {
+  return skiplist_.GetElementsByRange(start, end);
+}
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+std::vector<typename SortedMap<Member, Score, Hash, Allocator>::Entry>
+SortedMap<Member, Score, Hash, Allocator>::GetElementsByRevRange(int start, int end) {
+  return skiplist_.GetElementsByRevRange(start, end);
+}
+
+/*
+ * return all entries with a score within [min, max]
+ */
+template <typename Member, typename Score, typename Hash, typename Allocator>
+std::vector<typename SortedMap<Member, Score, Hash, Allocator>::Entry>
+SortedMap<Member, Score, Hash, Allocator>::GetElementsByScore(const Score& min, const Score& max) {
+  const SkiplistNode* node = skiplist_.head_;
+  for (int i = skiplist_.level_ - 1; i >= 0; --i) {
+    while (node->GetNext(i) && node->GetNext(i)->key_.score_ < min) {
+      node = node->GetNext(i);
+    }
+  }
+
+  std::vector<Entry> entries;
+  node = node->GetNext(0);
+  while (node && !(max < node->key_.score_)) {
+    entries.push_back(node->key_);
+    node = node->GetNext(0);
+  }
+  return entries;
+}
+
+template <typename Member, typename Score, typename Hash, typename Allocator>
+void SortedMap<Member, Score, Hash, Allocator>::Clear() {
+  index_.Clear();
+  skiplist_.Clear();
+}
+
+}  // namespace skiplist
@@ -0,0 +1,109 @@
+#include "sorted_map.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace skiplist {
+class SortedMapTest : public testing::Test {
+ protected:
+  static void SetUpTestSuite() { sorted_map = new SortedMap<std::string, double>(4); }
+  static void TearDownTestSuite() {
+    delete sorted_map;
+    sorted_map = nullptr;
+  }
+  static SortedMap<std::string, double>* sorted_map;
+};
+
+SortedMap<std::string, double>* SortedMapTest::sorted_map;
+
+TEST_F(SortedMapTest, Upsert) {
+  ASSERT_TRUE(sorted_map->Upsert("alice", 3));
+  ASSERT_TRUE(sorted_map->Upsert("bob", 1));
+  ASSERT_TRUE(sorted_map->Upsert("carol", 2));
+  ASSERT_TRUE(sorted_map->Upsert("dave", 2));
+  ASSERT_EQ(sorted_map->Size(), 4);
+
+  /* existing member, the score is updated */
+  ASSERT_FALSE(sorted_map->Upsert("bob", 4));
+  ASSERT_EQ(sorted_map->Size(), 4);
+
+  double score;
+  ASSERT_TRUE(sorted_map->GetScore("bob", &score));
+  ASSERT_EQ(score, 4);
+  ASSERT_FALSE(sorted_map->GetScore("member_not_exist", &score));
+
+  ASSERT_TRUE(sorted_map->Contains("alice"));
+  ASSERT_FALSE(sorted_map->Contains("member_not_exist"));
+}
+
+TEST_F(SortedMapTest, GetRankofMember) {
+  /* equal scores are ordered by member */
+  ASSERT_EQ(sorted_map->GetRankofMember("carol"), 0);
+  ASSERT_EQ(sorted_map->GetRankofMember("dave"), 1);
+  ASSERT_EQ(sorted_map->GetRankofMember("alice"), 2);
+  ASSERT_EQ(sorted_map->GetRankofMember("bob"), 3);
+  ASSERT_EQ(sorted_map->GetRankofMember("member_not_exist"), -1);
+}
+
+TEST_F(SortedMapTest, IncrBy) {
+  ASSERT_EQ(sorted_map->IncrBy("carol", 10), 12);
+  ASSERT_EQ(sorted_map->GetRankofMember("carol"), 3);
+  ASSERT_EQ(sorted_map->GetElementByRank(-1).member_, "carol");
+
+  ASSERT_EQ(sorted_map->IncrBy("erin", 5), 5);
+  ASSERT_EQ(sorted_map->Size(), 5);
+  ASSERT_EQ(sorted_map->GetRankofMember("erin"), 3);
+}
+
+TEST_F(SortedMapTest, GetElementsByRange) {
+  const std::vector<SortedMapEntry<std::string, double>>& e1 = sorted_map->GetElementsByRange(0, 1);
+  ASSERT_EQ(e1.size(), 2);
+  ASSERT_EQ(e1[0].member_, "dave");
+  ASSERT_EQ(e1[0].score_, 2);
+  ASSERT_EQ(e1[1].member_, "alice");
+
+  const std::vector<SortedMapEntry<std::string, double>>& e2 =
+      sorted_map->GetElementsByRevRange(0, 0);
+  ASSERT_EQ(e2.size(), 1);
+  ASSERT_EQ(e2[0].member_, "carol");
+}
+
+TEST_F(SortedMapTest, GetElementsByScore) {
+  const std::vector<SortedMapEntry<std::string, double>>& e1 = sorted_map->GetElementsByScore(3, 5);
+  ASSERT_EQ(e1.size(), 3);
+  ASSERT_EQ(e1[0].member_, "alice");
+  ASSERT_EQ(e1[1].member_, "bob");
+  ASSERT_EQ(e1[2].member_, "erin");
+
+  const std::vector<SortedMapEntry<std::string, double>>& e2 = sorted_map->GetElementsByScore(6, 7);
+  ASSERT_EQ(e2.size(), 0);
+}
+
+TEST_F(SortedMapTest, Deletion) {
+  ASSERT_TRUE(sorted_map->Delete("alice"));
+  ASSERT_FALSE(sorted_map->Delete("alice"));
+  ASSERT_FALSE(sorted_map->Contains("alice"));
+  ASSERT_EQ(sorted_map->Size(), 4);
+  ASSERT_EQ(sorted_map->GetRankofMember("bob"), 1);
+
+  sorted_map->Clear();
+  ASSERT_EQ(sorted_map->Size(), 0);
+  ASSERT_FALSE(sorted_map->Contains("bob"));
+}
+
+TEST(SortedMapRehashTest, ManyMembers) {
+  SortedMap<int, int> sorted_map;
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(sorted_map.Upsert(i, -i));
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    ASSERT_TRUE(sorted_map.Delete(i));
+  }
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(sorted_map.Contains(i), i % 2 == 1);
+  }
+  ASSERT_EQ(sorted_map.GetRankofMember(999), 0);
+  ASSERT_EQ(sorted_map.GetRankofMember(1), 499);
+}
+}  // namespace skiplist